@@ -0,0 +1,336 @@
+#include "benchmark.h"
+#include "hashmap_chained.cpp"
+#include "hashmap_probed.cpp"
+#include "linkedlist.cpp"
+#include "queue.cpp"
+#include "stack.cpp"
+#include "priority_queue.cpp"
+#include "sorting.cpp"
+#include "matrix.cpp"
+#include <memory>
+#include <queue>
+#include <random>
+
+/*
+ * Benchmarks of every container and algorithm in the repository.
+ *
+ *   benchmark [--size N] [--reps N] [--warmup N] [--filter SUBSTRING] [--json OUT] [--baseline IN] [--threshold F]
+ *             [--trace OUT] [--trace-interval MS]
+ *
+ * --size scales every workload (default 200000 elements). --baseline compares medians with an earlier --json run
+ * and exits with status 1 if any case got slower by more than --threshold (default 0.1, i.e. 10%). In a build with
+ * PRACTICE_TRACE, --trace appends a Trace_registry snapshot to OUT every --trace-interval ms (default 1000) and at
+ * exit. Invalid arguments, and a temporary directory that cannot be created, exit with status 2.
+ */
+
+vector<int> make_input(const string &distribution, int n, uint32_t seed = 42) {
+    std::mt19937 gen(seed);
+    vector<int> v(n);
+    for (auto &x: v) {
+        x = static_cast<int>(gen() % 1000000000);
+    }
+    if (distribution == "sorted" || distribution == "reversed" || distribution == "nearly_sorted") {
+        std::sort(v.begin(), v.end());
+    }
+    if (distribution == "reversed") {
+        std::reverse(v.begin(), v.end());
+    } else if (distribution == "nearly_sorted") {
+        for (int i = 0; i < n / 100; i++) {
+            std::swap(v[gen() % n], v[gen() % n]);
+        }
+    } else if (distribution == "few_unique") {
+        for (auto &x: v) {
+            x %= 16;
+        }
+    }
+    return v;
+}
+
+//traced under the caller's line, like a Matrix constructed there.
+Matrix<double> random_matrix(int n, int m, uint32_t seed = 7, Trace_label where = std::source_location::current()) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    vector<vector<double>> rows(n, vector<double>(m));
+    for (auto &row: rows) {
+        for (auto &x: row) {
+            x = dist(gen);
+        }
+    }
+    return Matrix<double>{rows, where};
+}
+
+int identity_hash(const int &key) { return key; }
+
+void bench_containers(Bench_runner &runner, int n) {
+    auto keys = make_input("random", n);
+    runner.run("hashmap_chained/put", n, [] {
+        return std::make_unique<Hashmap_chained<int, int>>(identity_hash, "bench hashmap_chained/put");
+    }, [&](auto &map) {
+        for (int k: keys) map->put(k, k);
+        return map.get();
+    });
+    runner.run("hashmap_chained/get", n, [&] {
+        auto map = std::make_unique<Hashmap_chained<int, int>>(identity_hash, "bench hashmap_chained/get");
+        for (int k: keys) map->put(k, k);
+        return map;
+    }, [&](auto &map) {
+        long sum = 0;
+        for (int k: keys) sum += map->get(k);
+        return sum;
+    });
+    auto hash = [](const int &key) { return static_cast<size_t>(key); };
+    runner.run("hashmap_probed/put", n, [&] {
+        return std::make_unique<Hashmap_probed<int, int>>(hash, "bench hashmap_probed/put");
+    }, [&](auto &map) {
+        for (int k: keys) map->put(k, k);
+        return map.get();
+    });
+    runner.run("hashmap_probed/has_key", n, [&] {
+        auto map = std::make_unique<Hashmap_probed<int, int>>(hash, "bench hashmap_probed/has_key");
+        for (int k: keys) map->put(k, k);
+        return map;
+    }, [&](auto &map) {
+        long found = 0;
+        for (int k: keys) found += map->has_key(k);
+        return found;
+    });
+    runner.run("linked_list/push_back", n, [] {
+        return std::make_unique<Linked_list<int>>("bench linked_list/push_back");
+    }, [&](auto &lst) {
+        for (int k: keys) lst->push_back(k);
+        return lst.get();
+    });
+    runner.run("linked_list/iterate", n, [&] {
+        auto lst = std::make_unique<Linked_list<int>>("bench linked_list/iterate");
+        for (int k: keys) lst->push_back(k);
+        return lst;
+    }, [](auto &lst) {
+        long sum = 0;
+        for (int k: *lst) sum += k;
+        return sum;
+    });
+    runner.run("linked_list/remove_front", n, [&] {
+        auto lst = std::make_unique<Linked_list<int>>("bench linked_list/remove_front");
+        for (int k: keys) lst->push_back(k);
+        return lst;
+    }, [](auto &lst) {
+        long sum = 0;
+        while (lst->get_size() != 0) sum += lst->remove(0);
+        return sum;
+    });
+    runner.run("queue/enqueue_dequeue", n, [] {
+        return std::make_unique<Queue<int>>("bench queue/enqueue_dequeue");
+    }, [&](auto &queue) {
+        long sum = 0;
+        for (int k: keys) queue->enqueue(k);
+        while (!queue->empty()) sum += queue->dequeue();
+        return sum;
+    });
+    runner.run("stack/push_pop", n, [] {
+        return std::make_unique<Stack<int>>("bench stack/push_pop");
+    }, [&](auto &stack) {
+        long sum = 0;
+        for (int k: keys) stack->push(k);
+        while (!stack->empty()) sum += stack->pop();
+        return sum;
+    });
+}
+
+template<typename Q>
+long drain(Q &queue, const vector<int> &keys) {
+    long sum = 0;
+    for (int k: keys) queue.push(k);
+    while (!queue.empty()) {
+        sum += queue.top();
+        queue.pop();
+    }
+    return sum;
+}
+
+void bench_priority_queues(Bench_runner &runner, int n) {
+    auto keys = make_input("random", n);
+    runner.run("priority_queue/4ary/push_pop", n, [] { return Priority_queue<int>(); },
+               [&](auto &queue) { return drain(queue, keys); });
+    runner.run("priority_queue/binary/push_pop", n, [] { return Priority_queue<int, std::less<int>, 2>(); },
+               [&](auto &queue) { return drain(queue, keys); });
+    runner.run("priority_queue/std/push_pop", n,
+               [] { return std::priority_queue<int, vector<int>, std::greater<int>>(); },
+               [&](auto &queue) { return drain(queue, keys); });
+    runner.run("priority_queue/4ary/heapify", n, [] { return 0; }, [&](int) {
+        Priority_queue<int> queue(keys.begin(), keys.end());
+        return queue.top();
+    });
+    runner.run("priority_queue/indexed/decrease_key", n, [&] {
+        auto queue = std::make_unique<Indexed_priority_queue<int>>();
+        for (int k: keys) queue->push(k);
+        return queue;
+    }, [&](auto &queue) {
+        for (int h = 0; h < n; h++) queue->decrease_key(h, queue->get(h) / 2);
+        return queue->top();
+    });
+}
+
+void bench_sorts(Bench_runner &runner, int n) {
+    for (string dist: {"random", "sorted", "reversed", "nearly_sorted", "few_unique"}) {
+        auto input = make_input(dist, n);
+        auto sort_case = [&](const string &name, long items, auto sort, bool threaded = false) {
+            auto setup = [&] { return vector<int>(input.begin(), input.begin() + items); };
+            auto body = [&](vector<int> &v) {
+                sort(v);
+                return v.front();
+            };
+            if (threaded) {
+                runner.run_threaded("sort/" + name + "/" + dist, items, setup, body);
+            } else {
+                runner.run("sort/" + name + "/" + dist, items, setup, body);
+            }
+        };
+        int small = std::min(n, 2000);
+        sort_case("bubble_sort", small, [](vector<int> &v) { bubble_sort(v); });
+        sort_case("insertion_sort", small, [](vector<int> &v) { insertion_sort(v, comp_int); });
+        sort_case("merge_sort", n, [](vector<int> &v) { merge_sort(v, comp_int); });
+        sort_case("quick_sort", n, [](vector<int> &v) { quick_sort(v, comp_int); });
+        sort_case("intro_sort", n, [](vector<int> &v) { intro_sort(v); });
+        sort_case("tim_sort", n, [](vector<int> &v) { tim_sort(v); });
+        sort_case("radix_sort", n, [](vector<int> &v) { radix_sort(v); });
+        sort_case("parallel_merge_sort", n, [](vector<int> &v) { parallel_merge_sort(v, comp_int); }, true);
+        sort_case("parallel_quick_sort", n, [](vector<int> &v) { parallel_quick_sort(v, comp_int); }, true);
+        sort_case("parallel_radix_sort", n, [](vector<int> &v) { parallel_radix_sort(v); }, true);
+        sort_case("partial_sort_100", n, [](vector<int> &v) { partial_sort(v, 100, comp_int); });
+        sort_case("top_k_100", n, [](vector<int> &v) {
+            Top_k<int> top(100, comp_int);
+            for (int x: v) top.push(x);
+            v[0] = top.result()[0];
+        });
+    }
+    auto gpas = make_input("random", n);
+    auto students = [&] {
+        vector<Student> v;
+        v.reserve(n);
+        for (int i = 0; i < n; i++) v.emplace_back(gpas[i] % 400 / 100.0, "student" + std::to_string(i));
+        return v;
+    };
+    runner.run("sort/tagged_sort/students", n, students, [](vector<Student> &v) {
+        tagged_sort(v, [](const Student &s) { return s.gpa; });
+        return v.front().gpa;
+    });
+    runner.run("sort/tim_sort/students", n, students, [](vector<Student> &v) {
+        tim_sort(v, [](const Student &a, const Student &b) { return a.gpa < b.gpa; });
+        return v.front().gpa;
+    });
+    //a memory limit of an eighth of the input, so the sort spills several runs and merges them back.
+    auto input = make_input("random", n);
+    char dir_template[] = "/tmp/benchmark.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+        std::cerr << "Cannot Create " << dir_template << std::endl;
+        std::exit(2);
+    }
+    string dir = dir_template;
+    {
+        std::ofstream out(dir + "/input", std::ios::binary);
+        out.write(reinterpret_cast<const char *>(input.data()), static_cast<std::streamsize>(n * sizeof(int)));
+    }
+    External_sort_config config;
+    config.memory_limit = std::max<size_t>(n * sizeof(int) / 8, 1 << 16);
+    config.block_size = 1 << 12;
+    config.temp_dir = dir;
+    runner.run_threaded("sort/external_sort/random", n, [] { return 0; }, [&](int) {
+        external_sort<int>(dir + "/input", dir + "/output", std::less<int>(), config);
+        return 0;
+    });
+    std::remove((dir + "/input").c_str());
+    std::remove((dir + "/output").c_str());
+    rmdir(dir.c_str());
+}
+
+void bench_matrices(Bench_runner &runner, int n) {
+    for (int size: {32, 128, 256}) {
+        string dim = std::to_string(size);
+        auto A = random_matrix(size, size, 1), B = random_matrix(size, size, 2);
+        long cube = static_cast<long>(size) * size * size;
+        runner.run("matrix/multiply/" + dim, cube, [] { return 0; }, [&](int) { return A.multiply(B); });
+        runner.run_threaded("matrix/multiply_parallel/" + dim, cube, [] { return 0; },
+                   [&](int) { return A.multiply(B, Matrix_parallel{default_threads(), 1 << 16}); });
+        runner.run("matrix/add/" + dim, size * size, [] { return 0; }, [&](int) { return A + B; });
+        runner.run("matrix/transpose/" + dim, size * size, [] { return 0; }, [&](int) { return ~A; });
+        runner.run("matrix/rref/" + dim, cube, [] { return 0; }, [&](int) { return A.rref(); });
+        runner.run("matrix/inverse/" + dim, cube, [] { return 0; }, [&](int) { return !A; });
+        runner.run("matrix/write_text/" + dim, size * size, [] { return std::ostringstream(); },
+                   [&](std::ostringstream &os) {
+                       A.write_text(os);
+                       return os.tellp();
+                   });
+    }
+    auto small = random_matrix(8, 8);
+    runner.run("matrix/det_cofactor/8", 1, [] { return 0; }, [&](int) { return small.det(); });
+    int sparse_n = std::max(n / 10, 100);
+    std::mt19937 gen(3);
+    vector<Sparse_matrix<double>::Triplet> triplets;
+    for (int k = 0; k < sparse_n * 10; k++) {
+        triplets.push_back({static_cast<int>(gen() % sparse_n), static_cast<int>(gen() % sparse_n), 1.0});
+    }
+    auto S = Sparse_matrix<double>::from_triplets(sparse_n, sparse_n, triplets);
+    vector<double> x(sparse_n, 1.0);
+    runner.run("sparse_matrix/spmv/" + std::to_string(sparse_n), S.nonzeros(), [] { return 0; },
+               [&](int) { return S * x; });
+    Fixed_matrix<double, 4, 4> F{{2, 0, 1, 0}, {1, 3, 2, 0}, {1, 1, 1, 1}, {0, 0, 1, 4}};
+    runner.run("fixed_matrix/4x4_multiply_inverse", n, [] { return 0; }, [&](int) {
+        Fixed_matrix<double, 4, 4> acc = F;
+        for (int i = 0; i < n; i++) acc = acc * !F;
+        return acc.get(0, 0);
+    });
+}
+
+int main(int argc, char **argv) {
+    Bench_runner runner;
+    int n = 200000;
+    string json, baseline, trace;
+    double threshold = 0.1;
+    int trace_interval = 1000;
+    for (int i = 1; i < argc; i += 2) {
+        string flag = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing Value for " << flag << std::endl;
+            return 2;
+        }
+        string value = argv[i + 1];
+        if (flag == "--size") {
+            n = std::stoi(value);
+            if (n < 1) {
+                std::cerr << "--size must be positive" << std::endl;
+                return 2;
+            }
+        }
+        else if (flag == "--reps") runner.reps = std::stoi(value);
+        else if (flag == "--warmup") runner.warmup = std::stoi(value);
+        else if (flag == "--filter") runner.filter = value;
+        else if (flag == "--json") json = value;
+        else if (flag == "--baseline") baseline = value;
+        else if (flag == "--threshold") threshold = std::stod(value);
+        else if (flag == "--trace") trace = value;
+        else if (flag == "--trace-interval") trace_interval = std::stoi(value);
+        else {
+            std::cerr << "Unknown flag " << flag << std::endl;
+            return 2;
+        }
+    }
+    std::ofstream trace_out;
+    std::unique_ptr<Trace_reporter> reporter;
+    if (!trace.empty()) {
+        trace_out.open(trace);
+        reporter = std::make_unique<Trace_reporter>(trace_out, std::chrono::milliseconds(trace_interval));
+    }
+    bench_containers(runner, n);
+    bench_priority_queues(runner, n);
+    bench_sorts(runner, n);
+    bench_matrices(runner, n);
+    reporter.reset();
+    if (!json.empty()) {
+        std::ofstream out(json);
+        runner.write_json(out);
+    }
+    if (!baseline.empty() && runner.compare(baseline, threshold) > 0) {
+        return 1;
+    }
+    return 0;
+}
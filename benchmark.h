@@ -0,0 +1,258 @@
+#ifndef DATA_STRUCTURES_BENCHMARK_H
+#define DATA_STRUCTURES_BENCHMARK_H
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Self-contained micro-benchmark harness: every case runs a few untimed warmup rounds, then `reps` timed rounds,
+ * each on fresh input from its setup function, and reports the median and p99 time per round. On Linux, hardware
+ * counters of the calling thread are read through perf_event_open when the kernel allows it; they are left out
+ * otherwise, and for cases run with run_threaded(). Results can be written as JSON and compared against an earlier
+ * JSON run to catch regressions.
+ */
+
+//cycles, instructions, cache misses and branch misses of the calling thread, as one perf event group.
+class Perf_counters {
+public:
+    static const int COUNT = 4;
+
+    Perf_counters() {
+#ifdef __linux__
+        const uint64_t configs[COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < COUNT; i++) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+            if (fds[i] < 0) {
+                close_all();
+                return;
+            }
+        }
+#endif
+    }
+
+    Perf_counters(const Perf_counters &) = delete;
+
+    Perf_counters &operator=(const Perf_counters &) = delete;
+
+    ~Perf_counters() { close_all(); }
+
+    [[nodiscard]] bool available() const { return fds[0] >= 0; }
+
+    static const char *name(int i) {
+        static const char *names[COUNT] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+        return names[i];
+    }
+
+    void start() {
+#ifdef __linux__
+        if (available()) {
+            ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    //counts since start(), or all zeros when counters are unavailable.
+    std::vector<uint64_t> stop() {
+        std::vector<uint64_t> values(COUNT, 0);
+#ifdef __linux__
+        if (available()) {
+            ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t buf[COUNT + 1];
+            if (read(fds[0], buf, sizeof(buf)) == sizeof(buf)) {
+                std::copy(buf + 1, buf + 1 + COUNT, values.begin());
+            }
+        }
+#endif
+        return values;
+    }
+
+private:
+    int fds[COUNT] = {-1, -1, -1, -1};
+
+    void close_all() {
+#ifdef __linux__
+        for (int &fd: fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+#endif
+    }
+};
+
+struct Bench_result {
+    std::string name;
+    long items; //elements processed per round, for the per-item column.
+    std::vector<double> samples_ns;
+    std::vector<double> counters; //per-round medians, in Perf_counters order; empty when unavailable or threaded.
+
+    [[nodiscard]] double percentile(double p) const {
+        std::vector<double> sorted{samples_ns};
+        std::sort(sorted.begin(), sorted.end());
+        auto rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    [[nodiscard]] double median() const { return percentile(0.5); }
+
+    [[nodiscard]] double p99() const { return percentile(0.99); }
+};
+
+class Bench_runner {
+public:
+    int warmup = 1;
+    int reps = 5;
+    std::string filter; //only cases whose name contains it run.
+
+    //times body(state) on a fresh state = setup() per round. The result of body is kept alive so it is not
+    //optimized away.
+    template<typename Setup, typename Body>
+    void run(const std::string &name, long items, Setup setup, Body body) {
+        measure(name, items, setup, body, true);
+    }
+
+    //as run(), for bodies that hand work to other threads. Perf_counters only count the calling thread, so the
+    //counters of such cases would be partial and are left out.
+    template<typename Setup, typename Body>
+    void run_threaded(const std::string &name, long items, Setup setup, Body body) {
+        measure(name, items, setup, body, false);
+    }
+
+    void write_json(std::ostream &os) const {
+        os << "{\"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            auto &r = results[i];
+            os << "  {\"name\": \"" << r.name << "\", \"items\": " << r.items << std::fixed << std::setprecision(1)
+               << ", \"median_ns\": " << r.median() << ", \"p99_ns\": " << r.p99();
+            for (size_t c = 0; c < r.counters.size(); c++) {
+                os << ", \"" << Perf_counters::name(static_cast<int>(c)) << "\": " << r.counters[c];
+            }
+            os << "}" << (i + 1 == results.size() ? "\n" : ",\n");
+        }
+        os << "]}\n";
+    }
+
+    //compares medians with a JSON file written by write_json(); returns the number of cases slower by more than
+    //threshold (0.1 = 10%).
+    int compare(const std::string &baseline_path, double threshold) const {
+        std::ifstream in(baseline_path);
+        if (!in) {
+            std::cerr << "Cannot Open " << baseline_path << std::endl;
+            return 1;
+        }
+        std::map<std::string, double> baseline;
+        std::string line;
+        while (std::getline(in, line)) {
+            auto name = field(line, "\"name\": \"", "\"");
+            auto median = field(line, "\"median_ns\": ", ",");
+            if (!name.empty() && !median.empty()) {
+                baseline[name] = std::stod(median);
+            }
+        }
+        int regressions = 0;
+        for (auto &r: results) {
+            auto it = baseline.find(r.name);
+            if (it == baseline.end() || it->second <= 0) {
+                continue;
+            }
+            double change = r.median() / it->second - 1;
+            if (change > threshold) {
+                regressions++;
+                std::cout << "REGRESSION " << r.name << ": " << std::fixed << std::setprecision(1) << change * 100
+                          << "% slower than baseline" << std::endl;
+            }
+        }
+        return regressions;
+    }
+
+private:
+    Perf_counters perf;
+    std::vector<Bench_result> results;
+
+    template<typename Setup, typename Body>
+    void measure(const std::string &name, long items, Setup &setup, Body &body, bool counted) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return;
+        }
+        Bench_result result{name, items, {}, {}};
+        std::vector<std::vector<uint64_t>> counts;
+        for (int round = 0; round < warmup + reps; round++) {
+            auto state = setup();
+            perf.start();
+            auto start = std::chrono::steady_clock::now();
+            keep(body(state));
+            auto end = std::chrono::steady_clock::now();
+            auto counters = perf.stop();
+            if (round >= warmup) {
+                result.samples_ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+                counts.push_back(std::move(counters));
+            }
+        }
+        if (counted && perf.available()) {
+            for (int i = 0; i < Perf_counters::COUNT; i++) {
+                std::vector<uint64_t> column;
+                for (auto &c: counts) {
+                    column.push_back(c[i]);
+                }
+                std::sort(column.begin(), column.end());
+                result.counters.push_back(static_cast<double>(column[column.size() / 2]));
+            }
+        }
+        print(std::cout, result);
+        results.push_back(std::move(result));
+    }
+
+    template<typename R>
+    static void keep(const R &value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    static std::string field(const std::string &line, const std::string &prefix, const std::string &end) {
+        auto begin = line.find(prefix);
+        if (begin == std::string::npos) {
+            return "";
+        }
+        begin += prefix.size();
+        return line.substr(begin, line.find(end, begin) - begin);
+    }
+
+    static void print(std::ostream &os, const Bench_result &r) {
+        std::ostringstream line;
+        line << std::left << std::setw(48) << r.name << std::right << std::fixed << std::setprecision(3)
+             << std::setw(12) << r.median() / 1e6 << " ms" << std::setw(12) << r.p99() / 1e6 << " ms p99"
+             << std::setprecision(2) << std::setw(10) << r.median() / std::max(r.items, 1L) << " ns/item";
+        if (!r.counters.empty()) {
+            line << std::setprecision(2) << "  IPC " << r.counters[1] / std::max(r.counters[0], 1.0)
+                 << std::setprecision(0) << "  cache-miss " << r.counters[2] << "  branch-miss " << r.counters[3];
+        }
+        os << line.str() << std::endl;
+    }
+};
+
+#endif //DATA_STRUCTURES_BENCHMARK_H
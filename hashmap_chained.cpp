@@ -2,6 +2,7 @@
 #include<utility>
 #include<iostream>
 #include "Map.h"
+#include "trace.h"
 using std::vector;
 using std::pair;
 using std::cout;
@@ -11,10 +12,18 @@ template<typename K, typename V>
 class Hashmap_chained : public Map<K, V>{
 public:
 
-    explicit Hashmap_chained(int (*hash) (const K& obj), double lambda = DEFAULT_LAMBDA) :
-    capacity(DEFAULT_CAPACITY), used(0), map(DEFAULT_CAPACITY), hash(hash), lambda(lambda){ }
+    explicit Hashmap_chained(int (*hash) (const K& obj), double lambda = DEFAULT_LAMBDA,
+                             Trace_label where = std::source_location::current()) :
+    capacity(DEFAULT_CAPACITY), used(0), map(DEFAULT_CAPACITY), hash(hash), lambda(lambda),
+    trace("Hashmap_chained", where){
+        trace.allocate(DEFAULT_CAPACITY * sizeof(Bucket));
+    }
+
+    //default load factor, named trace site.
+    Hashmap_chained(int (*hash) (const K& obj), Trace_label where) : Hashmap_chained(hash, DEFAULT_LAMBDA, where) {}
 
     void put(K key, V value) override{
+        auto timer = trace.time("put");
         if (load_factor() > lambda){
             rehash();
         }
@@ -22,14 +31,16 @@ public:
         for (auto &item : map[hash_value]) {
             if (item.first == key) {
                 item.second = std::move(value);
+                trace.moved();
                 return;
             }
         }
-        map[hash_value].push_back(pair<K, V>(std::move(key), std::move(value)));
+        append(map[hash_value], pair<K, V>(std::move(key), std::move(value)));
         used++;
     }
 
     bool remove(const K &key) override{
+        auto timer = trace.time("remove");
         int hash_value = hash(key) % capacity;
         for (auto it = map[hash_value].begin(); it != map[hash_value].end(); it++){
             if (it->first == key){
@@ -42,6 +53,7 @@ public:
     }
 
     bool has_key(const K &key) const override{
+        auto timer = trace.time("has_key");
         int hash_value = hash(key) % capacity;
         for (auto &item : map[hash_value]){
             if (item.first == key){
@@ -52,6 +64,7 @@ public:
     }
 
     V& get(const K &key) override{
+        auto timer = trace.time("get");
         int hash_value = hash(key) % capacity;
         for (auto &item : map[hash_value]){
             if (item.first == key){
@@ -64,23 +77,35 @@ public:
 private:
     const static int DEFAULT_CAPACITY = 5;
     constexpr static double DEFAULT_LAMBDA = 0.75f;
+    using Bucket = vector<pair<K, V>>;
     int (*hash) (const K& obj);
-    vector<vector<pair<K, V>>> map;
+    vector<Bucket> map;
     int capacity;
     int used;
     double lambda;
+    [[no_unique_address]] mutable Trace_site trace;
 
     inline double load_factor(){ return static_cast<double>(used) / capacity;}
 
     void rehash(){
         capacity = capacity * 2;
-        auto new_map = vector<vector<pair<K, V>>>(capacity);
+        auto new_map = vector<Bucket>(capacity);
+        trace.allocate(capacity * sizeof(Bucket));
         for (auto &lst : map){
             for (auto &item : lst){
-                new_map[hash(item.first) % capacity].push_back(item);
+                append(new_map[hash(item.first) % capacity], std::move(item));
             }
         }
-        map = new_map;
+        map = std::move(new_map);
+    }
+
+    void append(Bucket &bucket, pair<K, V> &&item){
+        auto old_capacity = bucket.capacity();
+        bucket.push_back(std::move(item));
+        trace.moved();
+        if (bucket.capacity() != old_capacity){
+            trace.allocate(bucket.capacity() * sizeof(pair<K, V>));
+        }
     }
 };
 
@@ -1,8 +1,10 @@
 #include "Map.h"
+#include "trace.h"
 #include <utility>
 #include <vector>
 #include <iostream>
 #include<map>
+#include <functional>
 
 using std::vector;
 using std::function;
@@ -24,12 +26,14 @@ private:
 
         Entry() : status(vacant) {}
 
-        Entry(K key, V value) : key(key), value(value), status(occupied) {}
+        Entry(K key, V value) : key(std::move(key)), value(std::move(value)), status(occupied) {}
     };
 
 public:
     using size_type = typename vector<Entry>::size_type;
-    using Hash_func = function<V(size_type)>;
+    //maps a key to a hash, which index() reduces modulo the capacity. It used to be function<V(size_type)>, which
+    //only worked when both K and V converted to size_type; pass e.g. [](const K &k){ return std::hash<K>{}(k); }.
+    using Hash_func = function<size_type(const K &)>;
     using Probe_func = function<size_type(size_type)>;
     static inline Probe_func linear_probing(int c1) {
         return [=](size_type step) { return c1 * step; };
@@ -48,6 +52,7 @@ private:
     const Hash_func hash;
     const Probe_func probe;
     vector<Entry> map;
+    [[no_unique_address]] mutable Trace_site trace;
 
     [[nodiscard]] inline double load_factor() const { return static_cast<double>(used) / capacity; }
 
@@ -59,14 +64,16 @@ private:
              new_map[pos].status == occupied;
              pos = probe(step) % capacity, step++);
        new_map[pos] = Entry(std::move(key), std::move(value));
+       trace.moved();
     }
 
     void rehash() {
         auto new_map = vector<Entry>(capacity * 2);
         capacity = capacity * 2;
+        trace.allocate(capacity * sizeof(Entry));
         for (auto &entry : map){
             if (entry.status == occupied){
-                put(new_map, entry.key, entry.value);
+                put(new_map, std::move(entry.key), std::move(entry.value));
             }
         }
         map = std::move(new_map);
@@ -81,11 +88,19 @@ private:
     }
 
 public:
-    explicit Hashmap_probed(Hash_func hash, Probe_func probe = linear_probing(1), double lambda = DEFAULT_LAMBDA) :
+    explicit Hashmap_probed(Hash_func hash, Probe_func probe = linear_probing(1), double lambda = DEFAULT_LAMBDA,
+                            Trace_label where = std::source_location::current()) :
             capacity(DEFAULT_CAPACITY), used(0), lambda(lambda), hash(std::move(hash)),
-            probe(std::move(probe)), map(DEFAULT_CAPACITY) {}
+            probe(std::move(probe)), map(DEFAULT_CAPACITY), trace("Hashmap_probed", where) {
+        trace.allocate(DEFAULT_CAPACITY * sizeof(Entry));
+    }
+
+    //default probing and load factor, named trace site.
+    Hashmap_probed(Hash_func hash, Trace_label where) :
+            Hashmap_probed(std::move(hash), linear_probing(1), DEFAULT_LAMBDA, where) {}
 
     void put(K key, V value) override {
+        auto timer = trace.time("put");
         if (load_factor() > lambda){
             rehash();
         }
@@ -94,21 +109,25 @@ public:
     };
 
     V &get(const K &key) override {
-        return static_cast<V&>(static_cast<const Hashmap_probed<K, V>>(*this).get(key));
+        return const_cast<V&>(static_cast<const Hashmap_probed<K, V>&>(*this).get(key));
     };
 
-    const V &get(const K &key) const override{
-        if (not has_key(key)){
+    const V &get(const K &key) const{
+        auto timer = trace.time("get");
+        auto pos = find(key);
+        if (not (map[pos].key == key)){
             throw Map_invalid_key_error();
         }
-        return map[find(key)].value;
+        return map[pos].value;
     }
 
     [[nodiscard]] bool has_key(const K &key) const override {
+        auto timer = trace.time("has_key");
         return map[find(key)].key == key;
     };
 
     bool remove(const K &key) override {
+        auto timer = trace.time("remove");
         auto pos = find(key);
         if (map[pos].key == key){
             map[pos].status = deleted;
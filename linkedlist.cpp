@@ -1,4 +1,5 @@
 #include "Node.h"
+#include "trace.h"
 #include <iostream>
 
 class List_invalid_index_error : public std::runtime_error {
@@ -13,6 +14,7 @@ private:
     Node<T> *head;
     Node<T> *tail;
     int size;
+    [[no_unique_address]] mutable Trace_site trace;
 
 public:
     struct Iterator {
@@ -54,10 +56,12 @@ public:
 
     Iterator end() { return Iterator(tail->next); }
 
-    Linked_list() : head(nullptr), tail(nullptr), size(0) {}
+    Linked_list(Trace_label where = std::source_location::current()) :
+            head(nullptr), tail(nullptr), size(0), trace("Linked_list", where) {}
 
-    Linked_list(const Linked_list<T> &other) : Linked_list() {
+    Linked_list(const Linked_list<T> &other) : head(nullptr), tail(nullptr), size(0), trace(other.trace) {
         for (auto item: other) push_back(item);
+        trace.copied(size);
     }
 
     ~Linked_list() {
@@ -86,10 +90,12 @@ public:
         }
         while (size != 0) remove(0);
         for (auto item: other) push_back(item);
+        trace.copied(size);
         return *this;
     }
 
     T &get(int pos) const {
+        auto timer = trace.time("get");
         if (pos >= size || pos < 0) {
             throw List_invalid_index_error(pos);
         }
@@ -106,7 +112,10 @@ public:
     }
 
     void insert(T data, int pos) {
-        auto node = new Node<T>{data};
+        auto timer = trace.time("insert");
+        auto node = new Node<T>{std::move(data)};
+        trace.allocate(sizeof(Node<T>));
+        trace.moved();
         if (pos > size || pos < 0) {
             throw List_invalid_index_error(pos);
         } else if (size == 0) {
@@ -131,11 +140,12 @@ public:
     }
 
     T remove(int pos) {
+        auto timer = trace.time("remove");
         T data;
         if (pos >= size || pos < 0) {
             throw List_invalid_index_error(pos);
         } else if (pos == 0) {
-            data = head->data;
+            data = std::move(head->data);
             auto head_next = head->next;
             delete head;
             head = head_next;
@@ -149,19 +159,20 @@ public:
                 now = now->next;
             }
             if (now->next == tail) {
-                data = tail->data;
+                data = std::move(tail->data);
                 delete tail;
                 tail = now;
                 tail->next = nullptr;
             } else {
-                data = now->next->data;
+                data = std::move(now->next->data);
                 auto new_next = now->next->next;
                 delete now->next;
                 now->next = new_next;
             }
         }
         size--;
-        return std::move(data);
+        trace.moved();
+        return data;
     }
 
     int get_size() const { return size; }
@@ -2,216 +2,559 @@
 #include <vector>
 #include <numeric>
 #include <algorithm>
+#include <functional>
+#include <array>
+#include <thread>
+#include <sstream>
+#include <charconv>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <cctype>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trace.h"
+#include "scheduler.h"
 using std::vector;
 using std::string;
 
+//header of the binary Matrix format, followed by n * m raw entries in row-major order. 32 bytes, so the
+//entries of a mapped file stay aligned for any arithmetic T.
+struct Matrix_header {
+    char magic[8];
+    uint64_t entry_size;
+    int64_t n;
+    int64_t m;
+
+    static constexpr char MAGIC[8] = {'M', 'A', 'T', 'R', 'I', 'X', '\0', '1'};
+
+    //Matrix indexes its entries with int, so a file's n * m must be positive and at most INT_MAX. Checked by
+    //division, before n * m is computed, so a corrupt header cannot overflow it.
+    static bool valid_dimensions(int64_t n, int64_t m){
+        return n > 0 && m > 0 && n <= INT_MAX / m;
+    }
+};
+
+//whether write_text()/read_text() format T with std::to_chars/from_chars, which have no overloads for bool.
+template<class T>
+constexpr bool chars_convertible = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+//how Matrix kernels split their work. Below `threshold` scalar operations (per call, or per pivot step in
+//rref) the kernel runs serially on the calling thread. Every entry is computed in the same order as the
+//serial kernel, so results are bit-for-bit identical whatever the thread count.
+struct Matrix_parallel {
+    int threads = 1;
+    long threshold = 1L << 16;
+
+    [[nodiscard]] bool serial(long work) const{ return threads <= 1 || work < threshold; }
+};
+
+//runs body(lo, hi) over [begin, end) split into about `threads` contiguous chunks, on the shared Scheduler.
+//Nested calls, e.g. from a kernel that is itself one task of a parallel sort, reuse the same workers.
+template<class F>
+void parallel_for(int begin, int end, int threads, const F &body){
+    int total = end - begin;
+    if (threads <= 1 || total <= 1){
+        body(begin, end);
+        return;
+    }
+    long grain = (total + threads - 1) / threads;
+    Scheduler::instance().parallel_for(begin, end, grain, [&body](long lo, long hi){
+        body(static_cast<int>(lo), static_cast<int>(hi));
+    });
+}
+
+template<class T>
+class Matrix;
+
+template<class T>
+class Sparse_matrix;
+
+//non-owning (n x m) window into the storage of a Matrix, described by a pointer, its dimensions and the
+//distance (in elements) between consecutive rows and columns. transpose/submatrix/row/col only rewrite those
+//four numbers, so they are O(1). The viewed Matrix must outlive the view.
+template<class T>
+class Matrix_view {
+private:
+    const T *p;
+    int n; //height.
+    int m; //width.
+    long row_stride;
+    long col_stride;
+
+    [[nodiscard]] T zero() const{ return get(0, 0) - get(0, 0); }
+
+    [[nodiscard]] T det_aux(vector<int> &cols) const{
+        //cofactor expansion along the first row. the minor is this view without its first row (a strided
+        //window) restricted to the columns still in cols, so no entry is ever copied.
+        if (cols.size() == 1){
+            return get(0, cols[0]);
+        }
+        auto rest = submatrix(1, 0, n - 1, m);
+        T sum = zero();
+        for (size_t i = 0; i < cols.size(); i++){
+            int c = cols[i];
+            cols.erase(cols.begin() + i);
+            T v = get(0, c) * rest.det_aux(cols);
+            cols.insert(cols.begin() + i, c);
+            if (i % 2 == 1){
+                sum = sum - v;
+            }
+            else{
+                sum = sum + v;
+            }
+        }
+        return sum;
+    }
+public:
+    Matrix_view(const T *p, int n, int m, long row_stride, long col_stride) :
+            p(p), n(n), m(m), row_stride(row_stride), col_stride(col_stride) {}
+
+    [[nodiscard]] int get_n() const { return n; }
+
+    [[nodiscard]] int get_m() const { return m; }
+
+    [[nodiscard]] const T &get(int i, int j) const { return p[i * row_stride + j * col_stride]; }
+
+    [[nodiscard]] Matrix_view<T> transpose() const{
+        return Matrix_view<T>{p, m, n, col_stride, row_stride};
+    }
+
+    [[nodiscard]] Matrix_view<T> submatrix(int i, int j, int rows, int cols) const{
+        if (i < 0 || j < 0 || rows <= 0 || cols <= 0 || i + rows > n || j + cols > m){
+            throw std::invalid_argument("Index Out of Range for Matrix_view.submatrix()");
+        }
+        return Matrix_view<T>{p + i * row_stride + j * col_stride, rows, cols, row_stride, col_stride};
+    }
+
+    [[nodiscard]] Matrix_view<T> row(int i) const{ return submatrix(i, 0, 1, m); }
+
+    [[nodiscard]] Matrix_view<T> col(int j) const{ return submatrix(0, j, n, 1); }
+
+    [[nodiscard]] Matrix_view<T> rows(int i, int count) const{ return submatrix(i, 0, count, m); }
+
+    [[nodiscard]] Matrix_view<T> cols(int j, int count) const{ return submatrix(0, j, n, count); }
+
+    [[nodiscard]] Matrix<T> multiply(const Matrix_view<T> &B, const Matrix_parallel &par = {}) const{
+        if (m != B.n){
+            throw std::invalid_argument("Inconsistent Dimension for Matrix.multiply");
+        }
+        vector<T> C(static_cast<size_t>(n) * B.m, get(0, 0));
+        //C is cut into TILE x TILE blocks handed out to threads; each entry is still one k-ordered dot product.
+        const int TILE = 64;
+        int tile_rows = (n + TILE - 1) / TILE;
+        int tile_cols = (B.m + TILE - 1) / TILE;
+        int threads = par.serial(static_cast<long>(n) * m * B.m) ? 1 : par.threads;
+        parallel_for(0, tile_rows * tile_cols, threads, [&](int lo, int hi){
+            for (int t = lo; t < hi; t++){
+                int i0 = t / tile_cols * TILE, j0 = t % tile_cols * TILE;
+                int i1 = std::min(i0 + TILE, n), j1 = std::min(j0 + TILE, B.m);
+                for (int i = i0; i < i1; i++){
+                    for (int j = j0; j < j1; j++){
+                        T sum = get(i, 0) * B.get(0, j);
+                        for (int k = 1; k < m; k++){
+                            sum += get(i, k) * B.get(k, j);
+                        }
+                        C[static_cast<size_t>(i) * B.m + j] = std::move(sum);
+                    }
+                }
+            }
+        });
+        return Matrix<T>{n, B.m, std::move(C)};
+    }
+
+    [[nodiscard]] T det() const{
+        if (n != m){
+            throw std::invalid_argument("Inconsistent Dimension for Matrix.det()");
+        }
+        vector<int> cols(m);
+        std::iota(cols.begin(), cols.end(), 0);
+        return det_aux(cols);
+    }
+
+    //writes "[  a | b  ]\n[  c | d  ]" to os, formatting each entry with formatter(T) -> string.
+    template<class F>
+    void write(std::ostream &os, const F &formatter) const{
+        os << "[  ";
+        for (int i = 0; i < n; i++){
+            if (i != 0){
+                os << "  ]\n[  ";
+            }
+            for (int j = 0; j < m; j++){
+                if (j != 0){
+                    os << " | ";
+                }
+                os << formatter(get(i, j));
+            }
+        }
+        os << "  ]";
+    }
+
+    [[nodiscard]] string to_string(std::function<string(T)> formatter) const{
+        std::ostringstream os;
+        write(os, formatter);
+        return os.str();
+    }
+
+    //writes "n m" and then one line of space separated entries per row, the format Matrix::read_text() parses.
+    //arithmetic entries go through std::to_chars (shortest round-trip form) into a local buffer.
+    void write_text(std::ostream &os) const{
+        os << n << ' ' << m << '\n';
+        if constexpr (chars_convertible<T>){
+            const int FLUSH = 1 << 16;
+            vector<char> buf(FLUSH + 64);
+            char *p = buf.data();
+            for (int i = 0; i < n; i++){
+                for (int j = 0; j < m; j++){
+                    p = std::to_chars(p, buf.data() + buf.size(), get(i, j)).ptr;
+                    *p++ = j + 1 == m ? '\n' : ' ';
+                    if (p - buf.data() >= FLUSH){
+                        os.write(buf.data(), p - buf.data());
+                        p = buf.data();
+                    }
+                }
+            }
+            os.write(buf.data(), p - buf.data());
+        }
+        else{
+            for (int i = 0; i < n; i++){
+                for (int j = 0; j < m; j++){
+                    os << get(i, j) << (j + 1 == m ? '\n' : ' ');
+                }
+            }
+        }
+    }
+
+    //writes a Matrix_header and the raw entries, one contiguous write per row when the row is contiguous.
+    void write_binary(std::ostream &os) const{
+        static_assert(std::is_trivially_copyable_v<T>, "binary Matrix I/O requires a trivially copyable T");
+        Matrix_header header{{}, sizeof(T), n, m};
+        std::memcpy(header.magic, Matrix_header::MAGIC, sizeof(header.magic));
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        vector<T> row(col_stride == 1 ? 0 : m);
+        for (int i = 0; i < n; i++){
+            const T *r = p + i * row_stride;
+            if (col_stride != 1){
+                for (int j = 0; j < m; j++){
+                    row[j] = get(i, j);
+                }
+                r = row.data();
+            }
+            os.write(reinterpret_cast<const char *>(r), static_cast<std::streamsize>(sizeof(T)) * m);
+        }
+    }
+};
+
 //(n x m) matrix over field F. immutable.
 template<class T>
 class Matrix {
     typedef vector<vector<T>> Mat_t;
     typedef vector<T> Row_t;
+    friend class Matrix_view<T>;
+    friend class Sparse_matrix<T>;
+    template<class U, int N, int M>
+    friend class Fixed_matrix;
 private:
     const int n; //height. Non-zero.
     const int m; //width. Non-zero.
-    const vector<vector<T>> M;
-    static Mat_t make_mat (int n, int m,  const T &v) {
-        return std::move(vector<vector<T>>(n, vector<T>(m, v)));
+    const vector<T> M; //row-major, n * m entries.
+    [[no_unique_address]] mutable Trace_site trace;
+    static Row_t make_mat (int n, int m,  const T &v) {
+        return Row_t(static_cast<size_t>(n) * m, v);
     }
-    [[nodiscard]] constexpr T M_0_0() const{ return M[0][0]; }
 
-    [[nodiscard]] constexpr T zero() const{ return M[0][0] - M[0][0]; }
+    static Row_t flatten(const Mat_t &A){
+        Row_t C;
+        C.reserve(A.size() * A[0].size());
+        for (auto &row: A) {
+            if (row.size() != A[0].size()) {
+                throw std::invalid_argument("Matrix Not Square in Matrix()");
+            }
+            C.insert(C.end(), row.begin(), row.end());
+        }
+        return C;
+    }
 
-    [[nodiscard]] constexpr T one() const{ return M[0][0] / M[0][0]; }
+    static Row_t gather(const Matrix_view<T> &A){
+        Row_t C;
+        C.reserve(static_cast<size_t>(A.get_n()) * A.get_m());
+        for (int i = 0; i < A.get_n(); i++){
+            for (int j = 0; j < A.get_m(); j++){
+                C.push_back(A.get(i, j));
+            }
+        }
+        return C;
+    }
 
-    [[nodiscard]] Matrix<T> remove_row(int i) const{
-        Mat_t C{M} ;
-        C.erase(C.begin() + i);
-        return Matrix<T>(C);
+    //results of Matrix operations come through here, so each is attributed to the line of this file that built
+    //it: every kernel reports its own site.
+    Matrix(int n, int m, Row_t &&M, Trace_label where = std::source_location::current()) :
+            n(n), m(m), M(std::move(M)), trace("Matrix", where) {
+        trace.allocate(this->M.size() * sizeof(T));
     }
 
+    [[nodiscard]] constexpr T M_0_0() const{ return M[0]; }
+
+    [[nodiscard]] constexpr T zero() const{ return M[0] - M[0]; }
+
+    [[nodiscard]] constexpr T one() const{ return M[0] / M[0]; }
+
     [[nodiscard]] Matrix<T> I(int l) const{
-        Mat_t C{make_mat(l, l, zero())};
+        Row_t C{make_mat(l, l, zero())};
         for (int i = 0; i < l; i++){
-            C[i][i] = one();
+            C[i * l + i] = one();
         }
-        return Matrix<T>(C);
+        return Matrix<T>(l, l, std::move(C));
     }
 
-    static Row_t subtract(const Row_t &r1, const T &factor, const Row_t &r2){
-        Row_t r3{r1};
-        for (int i = 0; i < r3.size(); i++){
-            r3[i] = r3[i] - factor * r2[i];
+    //r1 <- r1 - factor * r2 over the first `len` entries.
+    static void subtract(T *r1, T factor, const T *r2, int len){
+        for (int i = 0; i < len; i++){
+            r1[i] = r1[i] - factor * r2[i];
         }
-        return r3;
     }
 
-    static Row_t scale(const Row_t &r1, const T &c){
-        Row_t r3{r1};
-        for (int i = 0; i < r3.size(); i++){
-            r3[i] = r3[i] * c;
+    //r1 <- r1 / c over the first `len` entries.
+    static void divide(T *r1, T c, int len){
+        for (int i = 0; i < len; i++){
+            r1[i] = r1[i] / c;
         }
-        return r3;
     }
+public:
 
-    static Mat_t swap(const Mat_t &A, int i, int j){
-        Mat_t C{A};
-        std::iter_swap(C.begin() + i, C.begin() + j);
-        return C;
+    Matrix(int n, int m, const T &v = T(), Trace_label where = std::source_location::current()) :
+            n(n), m(m), M(make_mat(n, m, v)), trace("Matrix", where) {
+        trace.allocate(M.size() * sizeof(T));
     }
-public:
 
-    Matrix(int n, int m, const T &v = T()) : n(n), m(m), M(make_mat(n, m, v)) {}
+    explicit Matrix(const vector<vector<T>> &M, Trace_label where = std::source_location::current()) :
+            n(M.size()), m(M[0].size()), M(flatten(M)), trace("Matrix", where) {
+        trace.allocate(this->M.size() * sizeof(T));
+        trace.copied(static_cast<long>(this->M.size()));
+    }
 
-    explicit Matrix(const vector<vector<T>> &M) : n(M.size()), m(M[0].size()), M(std::move(M)) {
-        for (auto &row: M) {
-            if (row.size() != m) {
-                throw std::invalid_argument("Matrix Not Square in Matrix()");
-            }
-        }
+    explicit Matrix(const Matrix_view<T> &A, Trace_label where = std::source_location::current()) :
+            n(A.get_n()), m(A.get_m()), M(gather(A)), trace("Matrix", where) {
+        trace.allocate(M.size() * sizeof(T));
+        trace.copied(static_cast<long>(M.size()));
+    }
+
+    //the entries are const, so a Matrix cannot be moved from; every copy, including by-value returns that are
+    //not elided, duplicates the storage. The copy is attributed to the site of A.
+    Matrix(const Matrix<T> &A) : n(A.n), m(A.m), M(A.M), trace(A.trace) {
+        trace.allocate(M.size() * sizeof(T));
+        trace.copied(static_cast<long>(M.size()));
     }
 
     [[nodiscard]] int get_n() const { return n; }
 
     [[nodiscard]] int get_m() const { return m; }
 
-    [[nodiscard]] Mat_t to_vector() const{ return M; }
+    [[nodiscard]] Mat_t to_vector() const{
+        Mat_t C;
+        C.reserve(n);
+        for (int i = 0; i < n; i++){
+            C.emplace_back(M.begin() + i * m, M.begin() + (i + 1) * m);
+        }
+        return C;
+    }
+
+    [[nodiscard]] T get(int i, int j) const { return M[i * m + j]; }
 
-    [[nodiscard]] T get(int i, int j) const { return M[i][j]; }
+    [[nodiscard]] Matrix_view<T> view() const{ return Matrix_view<T>{M.data(), n, m, m, 1}; }
 
-    [[nodiscard]] Matrix<T> add(const Matrix<T> &B) const{
+    [[nodiscard]] Matrix<T> add(const Matrix<T> &B, const Matrix_parallel &par = {}) const{
         if (m != B.m || n != B.n) {
             throw std::invalid_argument("Inconsistent Dimension for Matrix.add()");
         }
-        Mat_t C{M};
-        for (int i = 0; i < n; i++) {
-            for (int j = 0; j < m; j++) {
-                C[i][j] = M[i][j] + B[i][j];
+        auto timer = trace.time("add");
+        Row_t C(M.size());
+        int size = static_cast<int>(C.size());
+        parallel_for(0, size, par.serial(size) ? 1 : par.threads, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) {
+                C[i] = M[i] + B.M[i];
             }
-        }
-        return std::move(Matrix<T>{C});
+        });
+        return Matrix<T>{n, m, std::move(C)};
     }
 
     [[nodiscard]] Matrix<T> transpose() const {
-        Mat_t C{make_mat(m, n, M_0_0())};
-        for (int i = 0; i < n; i++){
-            for (int j = 0; j < m; j++){
-                C[j][i] = M[i][j];
-            }
-        }
-        return std::move(Matrix<T>{C});
+        auto timer = trace.time("transpose");
+        return Matrix<T>{view().transpose()};
     }
 
-    [[nodiscard]] Matrix<T> multiply(const Matrix<T> &B) const{
-        if (m != B.n){
-            throw std::invalid_argument("Inconsistent Dimension for Matrix.multiply");
+    [[nodiscard]] Matrix<T> minor(int i, int j) const{
+        if (i < 0 || i >= n || j < 0 || j >= m || n == 1 || m == 1){
+            throw std::invalid_argument("Index Out of Range for Matrix.minor()");
         }
-        Mat_t C{make_mat(n, B.m, M_0_0())};
-        for (int i = 0; i < n; i++){
-            for (int j = 0; j < B.m; j++){
-                T sum = M[i][0] * B[0][j];
-                for (int k = 1; k < m; k++){
-                    sum += M[i][k] * B[k][j];
+        Row_t C;
+        C.reserve(static_cast<size_t>(n - 1) * (m - 1));
+        for (int r = 0; r < n; r++){
+            for (int c = 0; c < m && r != i; c++){
+                if (c != j){
+                    C.push_back(M[r * m + c]);
                 }
-                C[i][j] = sum;
             }
         }
-        return Matrix<T>{C};
+        return Matrix<T>{n - 1, m - 1, std::move(C)};
     }
 
-    [[nodiscard]] const T &det() const{
-        if (n != m){
-            throw std::invalid_argument("Inconsistent Dimension for Matrix.det()");
-        }
-        if (n == 1 && m == 1){
-            return M_0_0();
-        }
-        auto C = remove_row(0).transpose();
-        T sum = M[0][0] * C.remove_row(0).transpose().det();
-        for (int i = 1; i < m; i++){
-            T v = M[0][i] * C.remove_row(i).det();
-            if (i % 2 == 1){
-                sum = sum - v;
-            }
-            else{
-                sum = sum + v;
-            }
-        }
-        return sum;
+    [[nodiscard]] Matrix<T> multiply(const Matrix<T> &B, const Matrix_parallel &par = {}) const{
+        auto timer = trace.time("multiply");
+        return view().multiply(B.view(), par);
     }
 
-    [[nodiscard]] Matrix<T> rref() const{
-        Mat_t C{M};
+    [[nodiscard]] T det() const{
+        auto timer = trace.time("det");
+        return view().det();
+    }
+
+    [[nodiscard]] Matrix<T> rref(const Matrix_parallel &par = {}) const{
+        auto timer = trace.time("rref");
+        Row_t C{M};
+        trace.copied(static_cast<long>(C.size()));
         int rank = 0;
-        for (int i = 0; i < (m < n ? m : n); i++){
+        for (int i = 0; i < m && rank < n; i++){
             //outer loop: eliminate 1 at nth column
             bool flag = false;
             int id;
-            for (int j = i; j < n; j++){
+            for (int j = rank; j < n; j++){
                 //find first nonzero row
-                if (C[j][i] != zero()){
+                if (C[j * m + i] != zero()){
                     id = j;
                     flag = true;
                     break;
                 }
             }
             if (flag){
-                //if found, swap, scale and subtract all other rows
-                C = swap(C, id, rank);
-                C[i] = scale(C[rank], C[rank][i]);
-                rank++;
-                for (int k = 0; k < n; k++){
-                    if (k == rank){
-                        continue;
+                //if found, swap, scale and subtract all other rows. rows are independent within one pivot step.
+                std::swap_ranges(C.begin() + id * m, C.begin() + (id + 1) * m, C.begin() + rank * m);
+                T *pivot = C.data() + rank * m;
+                divide(pivot, pivot[i], m);
+                int threads = par.serial(static_cast<long>(n) * m) ? 1 : par.threads;
+                parallel_for(0, n, threads, [&](int lo, int hi){
+                    for (int k = lo; k < hi; k++){
+                        if (k != rank){
+                            T *row = C.data() + k * m;
+                            subtract(row, row[i], pivot, m);
+                        }
                     }
-                    C[k] = subtract(C[k], C[k][i], C[rank]);
-                }
+                });
+                rank++;
             }
         }
-        return Matrix<T>{C};
+        return Matrix<T>{n, m, std::move(C)};
     }
 
     [[nodiscard]] Matrix<T> concat_right(const Matrix<T>& B) const{
         if (n != B.n){
             throw std::invalid_argument("Inconsistent Dimension for Matrix.concat_right()");
         }
-        Mat_t C{make_mat(n, m + B.m, one())};
+        Row_t C;
+        C.reserve(static_cast<size_t>(n) * (m + B.m));
         for (int i = 0; i < n; i++){
-            for (int j = 0; j < m; j++){
-                C[i][j] = M[i][j];
-                C[i][j + m] = B[i][j];
-            }
+            C.insert(C.end(), M.begin() + i * m, M.begin() + (i + 1) * m);
+            C.insert(C.end(), B.M.begin() + i * B.m, B.M.begin() + (i + 1) * B.m);
         }
-        return Matrix<T>{C};
+        return Matrix<T>{n, m + B.m, std::move(C)};
     }
 
     [[nodiscard]] Matrix<T> inverse() const{
         if (n != m){
             throw std::invalid_argument("Matrix Not Square");
         }
+        auto timer = trace.time("inverse");
         auto I_n = I(n);
         auto C = concat_right(I_n).rref();
-        Mat_t A_inv{make_mat(n, n, zero())};
         for (int i = 0; i < n; i++){
             for (int j = 0; j < n; j++){
-                if (C[i][j] == I_n[i][j]){
+                if (C[i][j] != I_n[i][j]){
                     throw std::invalid_argument("Matrix Not Invertible");
                 }
-                A_inv[i][j] = C[i][j + n];
             }
         }
-        return Matrix<T>{A_inv};
+        return Matrix<T>{C.view().cols(n, n)};
     }
 
     [[nodiscard]] string to_string(std::function<string(T)> formatter) const{
-        auto s = std::accumulate(M.begin(), M.end(), string(),
-                        [&](const string &acc, const Row_t &r) -> string{
-            auto s = std::accumulate(r.begin(), r.end(), string(),
-                                     [&](const string &a, const T &b) -> string{
-                return a + (a.empty() ? "" : " | ") + formatter(b);
-            });
-            return acc + (acc.empty() ? "" : "  ]\n[  ") + s;
-        });
-        return "[  " + s + "  ]";
+        return view().to_string(std::move(formatter));
+    }
+
+    void write_text(std::ostream &os) const{ view().write_text(os); }
+
+    void write_binary(std::ostream &os) const{ view().write_binary(os); }
+
+    //parses the output of write_text(). Reads exactly n * m entries and leaves the stream just after the last
+    //one, so several matrices can follow each other in one stream.
+    static Matrix<T> read_text(std::istream &is){
+        long n, m;
+        if (!(is >> n >> m) || !Matrix_header::valid_dimensions(n, m)){
+            throw std::runtime_error("Malformed Header in Matrix.read_text()");
+        }
+        Row_t C;
+        C.reserve(static_cast<size_t>(n) * m);
+        if constexpr (chars_convertible<T>){
+            //arithmetic entries are copied token by token from the stream buffer into a fixed-size buffer for
+            //std::from_chars; the stream buffer already reads its source in blocks.
+            std::streambuf *buf = is.rdbuf();
+            char token[128];
+            int c = buf->sgetc();
+            for (long k = 0; k < n * m; k++){
+                while (c != EOF && std::isspace(c)){
+                    c = buf->snextc();
+                }
+                size_t length = 0;
+                while (c != EOF && !std::isspace(c) && length < sizeof(token)){
+                    token[length++] = static_cast<char>(c);
+                    c = buf->snextc();
+                }
+                //c is neither space nor EOF only when the token filled the buffer: too long for any T, and
+                //parsing the part read so far would split it into two entries.
+                T v;
+                auto [next, ec] = std::from_chars(token, token + length, v);
+                if (ec != std::errc() || next != token + length || (c != EOF && !std::isspace(c))){
+                    throw std::runtime_error("Malformed Entry in Matrix.read_text()");
+                }
+                C.push_back(v);
+            }
+            if (c == EOF){
+                is.setstate(std::ios::eofbit);
+            }
+        }
+        else{
+            T v;
+            for (long k = 0; k < n * m; k++){
+                if (!(is >> v)){
+                    throw std::runtime_error("Malformed Entry in Matrix.read_text()");
+                }
+                C.push_back(std::move(v));
+            }
+        }
+        return Matrix<T>{static_cast<int>(n), static_cast<int>(m), std::move(C)};
+    }
+
+    //reads the output of write_binary() with a single read of the entries.
+    static Matrix<T> read_binary(std::istream &is){
+        static_assert(std::is_trivially_copyable_v<T>, "binary Matrix I/O requires a trivially copyable T");
+        Matrix_header header{};
+        if (!is.read(reinterpret_cast<char *>(&header), sizeof(header))
+            || std::memcmp(header.magic, Matrix_header::MAGIC, sizeof(header.magic)) != 0
+            || header.entry_size != sizeof(T) || !Matrix_header::valid_dimensions(header.n, header.m)){
+            throw std::runtime_error("Malformed Header in Matrix.read_binary()");
+        }
+        Row_t C(static_cast<size_t>(header.n) * header.m);
+        if (!is.read(reinterpret_cast<char *>(C.data()), static_cast<std::streamsize>(sizeof(T) * C.size()))){
+            throw std::runtime_error("Truncated Data in Matrix.read_binary()");
+        }
+        return Matrix<T>{static_cast<int>(header.n), static_cast<int>(header.m), std::move(C)};
+    }
+
+    friend std::ostream &operator<< (std::ostream &os, const Matrix<T> &A){
+        A.view().write(os, [](const T &v) -> const T & { return v; });
+        return os;
     }
 
     friend Matrix<T> operator+ (const Matrix<T> &A, const Matrix<T> &B){
@@ -230,15 +573,432 @@ public:
         return A.inverse();
     }
 
-    const Row_t& operator[] (int i) const{
-        return M[i];
+    //pointer to the first entry of row i, so A[i][j] keeps working over the contiguous storage.
+    const T *operator[] (int i) const{
+        return M.data() + static_cast<size_t>(i) * m;
+    }
+};
+
+//read-only memory mapping of a file written by Matrix::write_binary(). view() exposes the entries in place,
+//so loading costs no copy; pages are faulted in as they are touched.
+template<class T>
+class Mapped_matrix {
+    static_assert(std::is_trivially_copyable_v<T>, "binary Matrix I/O requires a trivially copyable T");
+private:
+    void *addr;
+    size_t length;
+    int n;
+    int m;
+public:
+    explicit Mapped_matrix(const string &path) : addr(MAP_FAILED), length(0), n(0), m(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            throw std::runtime_error("Cannot Open " + path);
+        }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Matrix_header))){
+            length = st.st_size;
+            addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED){
+            throw std::runtime_error("Cannot Map " + path);
+        }
+        auto header = static_cast<const Matrix_header *>(addr);
+        if (std::memcmp(header->magic, Matrix_header::MAGIC, sizeof(header->magic)) != 0
+            || header->entry_size != sizeof(T) || !Matrix_header::valid_dimensions(header->n, header->m)
+            || length < sizeof(Matrix_header) + sizeof(T) * header->n * header->m){
+            munmap(addr, length);
+            throw std::runtime_error("Malformed Header in " + path);
+        }
+        n = static_cast<int>(header->n);
+        m = static_cast<int>(header->m);
+    }
+
+    Mapped_matrix(const Mapped_matrix &) = delete;
+
+    Mapped_matrix &operator=(const Mapped_matrix &) = delete;
+
+    ~Mapped_matrix(){
+        munmap(addr, length);
+    }
+
+    [[nodiscard]] Matrix_view<T> view() const{
+        auto entries = reinterpret_cast<const T *>(static_cast<const char *>(addr) + sizeof(Matrix_header));
+        return Matrix_view<T>{entries, n, m, m, 1};
+    }
+};
+
+//(N x M) matrix over field F with dimensions fixed at compile time and entries stored inline, so it never
+//allocates. Dimension mismatches are compile errors, and det/inverse are unrolled by template recursion
+//instead of going through the generic cofactor/rref paths. Meant for the 2x2-4x4 transforms of geometry code.
+template<class T, int N, int M>
+class Fixed_matrix {
+    static_assert(N > 0 && M > 0, "Fixed_matrix dimensions must be non-zero");
+private:
+    std::array<T, N * M> A;
+public:
+    constexpr Fixed_matrix() : A{} {}
+
+    constexpr Fixed_matrix(std::initializer_list<std::initializer_list<T>> rows) : A{} {
+        if (rows.size() != N){
+            throw std::invalid_argument("Inconsistent Dimension for Fixed_matrix()");
+        }
+        int i = 0;
+        for (auto &row: rows){
+            if (row.size() != M){
+                throw std::invalid_argument("Inconsistent Dimension for Fixed_matrix()");
+            }
+            std::copy(row.begin(), row.end(), A.begin() + i++ * M);
+        }
+    }
+
+    explicit Fixed_matrix(const Matrix<T> &B) : A{} {
+        if (B.get_n() != N || B.get_m() != M){
+            throw std::invalid_argument("Inconsistent Dimension for Fixed_matrix()");
+        }
+        for (int i = 0; i < N; i++){
+            std::copy(B[i], B[i] + M, A.begin() + i * M);
+        }
+    }
+
+    static constexpr Fixed_matrix<T, N, N> identity(){
+        Fixed_matrix<T, N, N> C;
+        for (int i = 0; i < N; i++){
+            C.set(i, i, T(1));
+        }
+        return C;
+    }
+
+    [[nodiscard]] Matrix<T> to_matrix() const{
+        return Matrix<T>{N, M, vector<T>(A.begin(), A.end())};
+    }
+
+    [[nodiscard]] static constexpr int get_n() { return N; }
+
+    [[nodiscard]] static constexpr int get_m() { return M; }
+
+    [[nodiscard]] constexpr const T &get(int i, int j) const { return A[i * M + j]; }
+
+    constexpr void set(int i, int j, const T &v) { A[i * M + j] = v; }
+
+    [[nodiscard]] constexpr Fixed_matrix<T, N, M> add(const Fixed_matrix<T, N, M> &B) const{
+        Fixed_matrix<T, N, M> C;
+        for (int i = 0; i < N * M; i++){
+            C.A[i] = A[i] + B.A[i];
+        }
+        return C;
+    }
+
+    [[nodiscard]] constexpr Fixed_matrix<T, M, N> transpose() const{
+        Fixed_matrix<T, M, N> C;
+        for (int i = 0; i < N; i++){
+            for (int j = 0; j < M; j++){
+                C.set(j, i, get(i, j));
+            }
+        }
+        return C;
+    }
+
+    template<int P>
+    [[nodiscard]] constexpr Fixed_matrix<T, N, P> multiply(const Fixed_matrix<T, M, P> &B) const{
+        Fixed_matrix<T, N, P> C;
+        for (int i = 0; i < N; i++){
+            for (int j = 0; j < P; j++){
+                T sum = get(i, 0) * B.get(0, j);
+                for (int k = 1; k < M; k++){
+                    sum += get(i, k) * B.get(k, j);
+                }
+                C.set(i, j, sum);
+            }
+        }
+        return C;
+    }
+
+    [[nodiscard]] constexpr Fixed_matrix<T, N - 1, M - 1> minor(int r, int c) const{
+        Fixed_matrix<T, N - 1, M - 1> C;
+        for (int i = 0, ci = 0; i < N; i++){
+            if (i == r){
+                continue;
+            }
+            for (int j = 0, cj = 0; j < M; j++){
+                if (j != c){
+                    C.set(ci, cj++, get(i, j));
+                }
+            }
+            ci++;
+        }
+        return C;
+    }
+
+    [[nodiscard]] constexpr T det() const{
+        static_assert(N == M, "Fixed_matrix.det() requires a square matrix");
+        if constexpr (N == 1){
+            return A[0];
+        }
+        else if constexpr (N == 2){
+            return A[0] * A[3] - A[1] * A[2];
+        }
+        else if constexpr (N == 3){
+            return A[0] * (A[4] * A[8] - A[5] * A[7])
+                   - A[1] * (A[3] * A[8] - A[5] * A[6])
+                   + A[2] * (A[3] * A[7] - A[4] * A[6]);
+        }
+        else{
+            T sum = A[0] * minor(0, 0).det();
+            for (int j = 1; j < M; j++){
+                T v = A[j] * minor(0, j).det();
+                sum = j % 2 == 1 ? sum - v : sum + v;
+            }
+            return sum;
+        }
+    }
+
+    //adjugate over determinant.
+    [[nodiscard]] constexpr Fixed_matrix<T, N, N> inverse() const{
+        static_assert(N == M, "Fixed_matrix.inverse() requires a square matrix");
+        T d = det();
+        if (d == T()){
+            throw std::invalid_argument("Matrix Not Invertible");
+        }
+        Fixed_matrix<T, N, N> C;
+        if constexpr (N == 1){
+            C.set(0, 0, T(1) / d);
+        }
+        else{
+            for (int i = 0; i < N; i++){
+                for (int j = 0; j < N; j++){
+                    T cofactor = minor(i, j).det();
+                    C.set(j, i, (i + j) % 2 == 1 ? -cofactor / d : cofactor / d);
+                }
+            }
+        }
+        return C;
+    }
+
+    friend constexpr Fixed_matrix<T, N, M> operator+ (const Fixed_matrix<T, N, M> &A, const Fixed_matrix<T, N, M> &B){
+        return A.add(B);
+    }
+
+    template<int P>
+    friend constexpr Fixed_matrix<T, N, P> operator* (const Fixed_matrix<T, N, M> &A, const Fixed_matrix<T, M, P> &B){
+        return A.multiply(B);
+    }
+
+    friend constexpr Fixed_matrix<T, M, N> operator~ (const Fixed_matrix<T, N, M> &A){
+        return A.transpose();
+    }
+
+    friend constexpr Fixed_matrix<T, N, N> operator! (const Fixed_matrix<T, N, M> &A){
+        return A.inverse();
+    }
+
+    constexpr const T *operator[] (int i) const{
+        return A.data() + i * M;
+    }
+};
+
+//(n x m) matrix in compressed sparse row (CSR) form: only nonzero entries are stored, so memory and the cost of
+//every operation are proportional to the number of nonzeros. The transpose is the same matrix in CSC form.
+//immutable.
+template<class T>
+class Sparse_matrix {
+public:
+    struct Triplet {
+        int i;
+        int j;
+        T v;
+    };
+private:
+    int n; //height.
+    int m; //width.
+    vector<int> row_ptr; //row i occupies [row_ptr[i], row_ptr[i + 1]) of col_idx and val.
+    vector<int> col_idx; //column of each stored entry, increasing within a row.
+    vector<T> val;
+
+    Sparse_matrix(int n, int m, vector<int> &&row_ptr, vector<int> &&col_idx, vector<T> &&val) :
+            n(n), m(m), row_ptr(std::move(row_ptr)), col_idx(std::move(col_idx)), val(std::move(val)) {}
+public:
+    explicit Sparse_matrix(const Matrix<T> &A) : n(A.get_n()), m(A.get_m()), row_ptr(1, 0) {
+        row_ptr.reserve(n + 1);
+        for (int i = 0; i < n; i++){
+            for (int j = 0; j < m; j++){
+                if (A[i][j] != T()){
+                    col_idx.push_back(j);
+                    val.push_back(A[i][j]);
+                }
+            }
+            row_ptr.push_back(static_cast<int>(val.size()));
+        }
+    }
+
+    //builds from coordinate triplets in any order; duplicates are summed and zero sums are not stored.
+    static Sparse_matrix<T> from_triplets(int n, int m, vector<Triplet> triplets){
+        for (auto &t: triplets){
+            if (t.i < 0 || t.i >= n || t.j < 0 || t.j >= m){
+                throw std::invalid_argument("Index Out of Range for Sparse_matrix.from_triplets()");
+            }
+        }
+        std::sort(triplets.begin(), triplets.end(), [](const Triplet &a, const Triplet &b){
+            return a.i < b.i || (a.i == b.i && a.j < b.j);
+        });
+        vector<int> row_ptr(n + 1, 0);
+        vector<int> col_idx;
+        vector<T> val;
+        for (size_t k = 0; k < triplets.size();){
+            auto &t = triplets[k];
+            T sum = std::move(t.v);
+            for (k++; k < triplets.size() && triplets[k].i == t.i && triplets[k].j == t.j; k++){
+                sum = sum + triplets[k].v;
+            }
+            if (sum != T()){
+                row_ptr[t.i + 1]++;
+                col_idx.push_back(t.j);
+                val.push_back(std::move(sum));
+            }
+        }
+        for (int i = 0; i < n; i++){
+            row_ptr[i + 1] += row_ptr[i];
+        }
+        return Sparse_matrix<T>{n, m, std::move(row_ptr), std::move(col_idx), std::move(val)};
+    }
+
+    [[nodiscard]] int get_n() const { return n; }
+
+    [[nodiscard]] int get_m() const { return m; }
+
+    [[nodiscard]] int nonzeros() const { return static_cast<int>(val.size()); }
+
+    [[nodiscard]] T get(int i, int j) const{
+        auto begin = col_idx.begin() + row_ptr[i], end = col_idx.begin() + row_ptr[i + 1];
+        auto it = std::lower_bound(begin, end, j);
+        return it != end && *it == j ? val[it - col_idx.begin()] : T();
+    }
+
+    [[nodiscard]] Matrix<T> to_dense() const{
+        vector<T> C(static_cast<size_t>(n) * m, T());
+        for (int i = 0; i < n; i++){
+            for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++){
+                C[static_cast<size_t>(i) * m + col_idx[k]] = val[k];
+            }
+        }
+        return Matrix<T>{n, m, std::move(C)};
+    }
+
+    [[nodiscard]] vector<T> multiply(const vector<T> &x) const{
+        if (static_cast<size_t>(m) != x.size()){
+            throw std::invalid_argument("Inconsistent Dimension for Sparse_matrix.multiply()");
+        }
+        vector<T> y(n, T());
+        for (int i = 0; i < n; i++){
+            T sum = T();
+            for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++){
+                sum += val[k] * x[col_idx[k]];
+            }
+            y[i] = std::move(sum);
+        }
+        return y;
+    }
+
+    [[nodiscard]] Matrix<T> multiply(const Matrix<T> &B) const{
+        if (m != B.get_n()){
+            throw std::invalid_argument("Inconsistent Dimension for Sparse_matrix.multiply()");
+        }
+        //row i of the product is the combination of the rows of B picked out by the nonzeros of row i.
+        int p = B.get_m();
+        vector<T> C(static_cast<size_t>(n) * p, T());
+        for (int i = 0; i < n; i++){
+            T *c = C.data() + static_cast<size_t>(i) * p;
+            for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++){
+                const T *b = B[col_idx[k]];
+                for (int j = 0; j < p; j++){
+                    c[j] += val[k] * b[j];
+                }
+            }
+        }
+        return Matrix<T>{n, p, std::move(C)};
+    }
+
+    [[nodiscard]] Sparse_matrix<T> transpose() const{
+        //counting sort of the entries by column.
+        vector<int> t_ptr(m + 1, 0);
+        for (int j: col_idx){
+            t_ptr[j + 1]++;
+        }
+        for (int j = 0; j < m; j++){
+            t_ptr[j + 1] += t_ptr[j];
+        }
+        vector<int> next{t_ptr.begin(), t_ptr.end() - 1};
+        vector<int> t_idx(val.size());
+        vector<T> t_val(val.size());
+        for (int i = 0; i < n; i++){
+            for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++){
+                int dest = next[col_idx[k]]++;
+                t_idx[dest] = i;
+                t_val[dest] = val[k];
+            }
+        }
+        return Sparse_matrix<T>{m, n, std::move(t_ptr), std::move(t_idx), std::move(t_val)};
+    }
+
+    [[nodiscard]] Sparse_matrix<T> add(const Sparse_matrix<T> &B) const{
+        if (m != B.m || n != B.n){
+            throw std::invalid_argument("Inconsistent Dimension for Sparse_matrix.add()");
+        }
+        vector<int> c_ptr(1, 0);
+        vector<int> c_idx;
+        vector<T> c_val;
+        c_ptr.reserve(n + 1);
+        c_idx.reserve(val.size() + B.val.size());
+        c_val.reserve(val.size() + B.val.size());
+        for (int i = 0; i < n; i++){
+            //merge the two sorted rows, dropping entries that cancel out.
+            int a = row_ptr[i], b = B.row_ptr[i];
+            while (a < row_ptr[i + 1] || b < B.row_ptr[i + 1]){
+                if (b == B.row_ptr[i + 1] || (a < row_ptr[i + 1] && col_idx[a] < B.col_idx[b])){
+                    c_idx.push_back(col_idx[a]);
+                    c_val.push_back(val[a++]);
+                }
+                else if (a == row_ptr[i + 1] || B.col_idx[b] < col_idx[a]){
+                    c_idx.push_back(B.col_idx[b]);
+                    c_val.push_back(B.val[b++]);
+                }
+                else{
+                    T v = val[a] + B.val[b];
+                    if (v != T()){
+                        c_idx.push_back(col_idx[a]);
+                        c_val.push_back(std::move(v));
+                    }
+                    a++;
+                    b++;
+                }
+            }
+            c_ptr.push_back(static_cast<int>(c_val.size()));
+        }
+        return Sparse_matrix<T>{n, m, std::move(c_ptr), std::move(c_idx), std::move(c_val)};
+    }
+
+    friend Sparse_matrix<T> operator+ (const Sparse_matrix<T> &A, const Sparse_matrix<T> &B){
+        return A.add(B);
+    }
+
+    friend Matrix<T> operator* (const Sparse_matrix<T> &A, const Matrix<T> &B){
+        return A.multiply(B);
+    }
+
+    friend vector<T> operator* (const Sparse_matrix<T> &A, const vector<T> &x){
+        return A.multiply(x);
+    }
+
+    friend Sparse_matrix<T> operator~ (const Sparse_matrix<T> &A){
+        return A.transpose();
     }
 };
 
-int main(){
-    Matrix<double> A{vector<vector<double>>{vector<double>{1, 2, 3}, vector<double>{4, 5, 6}, vector<double>{7, 8, 9}}};
-    Matrix<double> B{2, 2, 2.8};
-    std::cout << A.det() << std::endl;
-    auto C = !A;
-    std::cout << C.to_string([](double d){ return std::to_string(d); }) << std::endl;
-}
\ No newline at end of file
+//int main(){
+//    Matrix<double> A{vector<vector<double>>{vector<double>{1, 2, 3}, vector<double>{4, 5, 6}, vector<double>{7, 8, 9}}};
+//    Matrix<double> B{2, 2, 2.8};
+//    std::cout << A.det() << std::endl;
+//    auto C = !A;
+//    std::cout << C.to_string([](double d){ return std::to_string(d); }) << std::endl;
+//}
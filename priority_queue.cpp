@@ -0,0 +1,301 @@
+#include <vector>
+#include <functional>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+
+using std::vector;
+
+class EmptyPriorityQueueException: public std::exception{
+public:
+    [[nodiscard]] const char * what() const noexcept override{
+        return "Attempt to Pop/Peek an Empty Priority Queue";
+    }
+};
+
+class Invalid_handle_error : public std::runtime_error {
+public:
+    explicit Invalid_handle_error(int handle) :
+            runtime_error("Invalid Handle--" + std::to_string(handle)) {};
+};
+
+/*
+ * Implicit d-ary heap in one contiguous vector: the children of slot i are slots d*i+1 ... d*i+d.
+ * top() is the least element under Less, so Less = std::greater<T> gives a max-heap. With d = 4 the children of a
+ * node share a cache line for small T and the tree is half as deep as a binary heap.
+ */
+template<typename T, typename Less = std::less<T>, int D = 4>
+class Priority_queue{
+    static_assert(D >= 2, "Priority_queue needs at least 2 children per node");
+public:
+    explicit Priority_queue(Less less = Less()) : less(std::move(less)) {}
+
+    //builds the heap from [first, last) in O(n) by sifting down every parent, last one first.
+    template<typename It>
+    Priority_queue(It first, It last, Less less = Less()) : heap(first, last), less(std::move(less)) {
+        if (heap.size() < 2){
+            return;
+        }
+        for (int i = parent(static_cast<int>(heap.size()) - 1); i >= 0; i--){
+            sift_down(i);
+        }
+    }
+
+    void push(T data){
+        heap.push_back(std::move(data));
+        sift_up(static_cast<int>(heap.size()) - 1);
+    }
+
+    T pop(){
+        if (heap.empty()){
+            throw EmptyPriorityQueueException();
+        }
+        T data = std::move(heap.front());
+        T last = std::move(heap.back());
+        heap.pop_back();
+        if (!heap.empty()){
+            //walk the hole at the root down to a leaf along least children, then sift the last element up from
+            //there: it usually belongs near the bottom, so this saves the comparison against it on every level.
+            int i = hole_to_leaf(0);
+            heap[i] = std::move(last);
+            sift_up(i);
+        }
+        return data;
+    }
+
+    const T &top() const{
+        if (heap.empty()){
+            throw EmptyPriorityQueueException();
+        }
+        return heap.front();
+    }
+
+    bool empty() const { return heap.empty(); }
+    int get_size() const { return static_cast<int>(heap.size()); }
+private:
+    vector<T> heap;
+    Less less;
+
+    static int parent(int i){ return (i - 1) / D; }
+
+    void sift_up(int i){
+        T data = std::move(heap[i]);
+        while (i > 0 && less(data, heap[parent(i)])){
+            heap[i] = std::move(heap[parent(i)]);
+            i = parent(i);
+        }
+        heap[i] = std::move(data);
+    }
+
+    int least_child(int first, int size) const{
+        //select the least child by index, so each step is a conditional move, not a hard-to-predict branch. A full
+        //family gets a loop with a constant trip count, which the compiler unrolls.
+        const T *family = heap.data() + first;
+        int best = 0;
+        if (size - first >= D){
+            for (int c = 1; c < D; c++){
+                best = less(family[c], family[best]) ? c : best;
+            }
+        }
+        else{
+            for (int c = 1; c < size - first; c++){
+                best = less(family[c], family[best]) ? c : best;
+            }
+        }
+        return first + best;
+    }
+
+    int hole_to_leaf(int i){
+        int size = static_cast<int>(heap.size());
+        for (int first = D * i + 1; first < size; first = D * i + 1){
+            int best = least_child(first, size);
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        return i;
+    }
+
+    void sift_down(int i){
+        int size = static_cast<int>(heap.size());
+        T data = std::move(heap[i]);
+        while (true){
+            int first = D * i + 1;
+            if (first >= size){
+                break;
+            }
+            int best = least_child(first, size);
+            if (!less(heap[best], data)){
+                break;
+            }
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        heap[i] = std::move(data);
+    }
+};
+
+/*
+ * Priority_queue whose elements stay addressable: push() returns a handle that remains valid until the element is
+ * popped or erased, and decrease_key()/update()/erase() find the element through it in O(1) before restoring the
+ * heap in O(log_d n). The heap holds handles; values live in a slot table indexed by handle, and freed slots are
+ * reused. Meant for schedulers and Dijkstra-style relaxations.
+ */
+template<typename T, typename Less = std::less<T>, int D = 4>
+class Indexed_priority_queue{
+    static_assert(D >= 2, "Indexed_priority_queue needs at least 2 children per node");
+public:
+    using Handle = int;
+
+    explicit Indexed_priority_queue(Less less = Less()) : less(std::move(less)) {}
+
+    Handle push(T data){
+        Handle h;
+        if (free_handles.empty()){
+            h = static_cast<Handle>(values.size());
+            values.push_back(std::move(data));
+            pos.push_back(0);
+        }
+        else{
+            h = free_handles.back();
+            free_handles.pop_back();
+            values[h] = std::move(data);
+        }
+        pos[h] = static_cast<int>(heap.size());
+        heap.push_back(h);
+        sift_up(pos[h]);
+        return h;
+    }
+
+    T pop(){
+        if (heap.empty()){
+            throw EmptyPriorityQueueException();
+        }
+        Handle h = heap.front();
+        T data = std::move(values[h]);
+        remove_at(0);
+        return data;
+    }
+
+    const T &top() const{
+        if (heap.empty()){
+            throw EmptyPriorityQueueException();
+        }
+        return values[heap.front()];
+    }
+
+    Handle top_handle() const{
+        if (heap.empty()){
+            throw EmptyPriorityQueueException();
+        }
+        return heap.front();
+    }
+
+    const T &get(Handle h) const{
+        check(h);
+        return values[h];
+    }
+
+    //replaces the value of h with one that is not greater under Less.
+    void decrease_key(Handle h, T data){
+        check(h);
+        if (less(values[h], data)){
+            throw std::invalid_argument("New Key Is Greater in Indexed_priority_queue.decrease_key()");
+        }
+        values[h] = std::move(data);
+        sift_up(pos[h]);
+    }
+
+    //replaces the value of h with any value.
+    void update(Handle h, T data){
+        check(h);
+        bool up = less(data, values[h]);
+        values[h] = std::move(data);
+        if (up){
+            sift_up(pos[h]);
+        }
+        else{
+            sift_down(pos[h]);
+        }
+    }
+
+    void erase(Handle h){
+        check(h);
+        remove_at(pos[h]);
+    }
+
+    bool contains(Handle h) const{
+        return h >= 0 && h < static_cast<Handle>(pos.size()) && pos[h] != NOT_IN_HEAP;
+    }
+
+    bool empty() const { return heap.empty(); }
+    int get_size() const { return static_cast<int>(heap.size()); }
+private:
+    static const int NOT_IN_HEAP = -1;
+    vector<Handle> heap;
+    vector<T> values; //values[h] is the value of handle h.
+    vector<int> pos; //pos[h] is the heap slot of handle h, or NOT_IN_HEAP.
+    vector<Handle> free_handles;
+    Less less;
+
+    static int parent(int i){ return (i - 1) / D; }
+
+    void check(Handle h) const{
+        if (!contains(h)){
+            throw Invalid_handle_error(h);
+        }
+    }
+
+    void place(int i, Handle h){
+        heap[i] = h;
+        pos[h] = i;
+    }
+
+    void remove_at(int i){
+        Handle h = heap[i];
+        Handle last = heap.back();
+        heap.pop_back();
+        pos[h] = NOT_IN_HEAP;
+        free_handles.push_back(h);
+        if (i < get_size()){
+            place(i, last);
+            if (i > 0 && less(values[last], values[heap[parent(i)]])){
+                sift_up(i);
+            }
+            else{
+                sift_down(i);
+            }
+        }
+    }
+
+    void sift_up(int i){
+        Handle h = heap[i];
+        while (i > 0 && less(values[h], values[heap[parent(i)]])){
+            place(i, heap[parent(i)]);
+            i = parent(i);
+        }
+        place(i, h);
+    }
+
+    void sift_down(int i){
+        int size = static_cast<int>(heap.size());
+        Handle h = heap[i];
+        while (true){
+            int first = D * i + 1;
+            if (first >= size){
+                break;
+            }
+            int best = first;
+            for (int c = first + 1; c < first + D && c < size; c++){
+                if (less(values[heap[c]], values[heap[best]])){
+                    best = c;
+                }
+            }
+            if (!less(values[heap[best]], values[h])){
+                break;
+            }
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, h);
+    }
+};
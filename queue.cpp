@@ -1,4 +1,5 @@
 #include "Node.h"
+#include "trace.h"
 #include<iostream>
 class EmptyQueueException: public std::exception{
 public:
@@ -14,12 +15,15 @@ public:
 template <typename T>
 class Queue{
 public:
-    Queue(){
+    Queue(Trace_label where = std::source_location::current()) : trace("Queue", where){
         head = tail = nullptr;
         size = 0;
     }
     void enqueue(T data){
+        auto timer = trace.time("enqueue");
         auto ptr = new Node<T>{std::move(data), tail};
+        trace.allocate(sizeof(Node<T>));
+        trace.moved();
         if (size == 0){
             head = tail = ptr;
         }
@@ -30,12 +34,14 @@ public:
         size += 1;
     }
     T dequeue(){
+        auto timer = trace.time("dequeue");
         T data;
         if (size == 0){
             throw EmptyQueueException();
         }
         else{
-            data = head->data;
+            data = std::move(head->data);
+            trace.moved();
             auto new_head = head->next;
             delete head;
             head = new_head;
@@ -58,6 +64,7 @@ private:
     Node<T> *head;
     Node<T> *tail;
     int size;
+    [[no_unique_address]] Trace_site trace;
 };
 
 //int main(){
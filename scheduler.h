@@ -0,0 +1,558 @@
+#ifndef DATA_STRUCTURES_SCHEDULER_H
+#define DATA_STRUCTURES_SCHEDULER_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+ * Work-stealing thread pool shared by the parallel sorts and the Matrix kernels.
+ *
+ * Every worker owns a Chase-Lev deque: it pushes and pops tasks at the bottom, and idle workers steal from the
+ * top, so a worker keeps its newest (cache-warm, smallest) tasks and thieves take the oldest (largest) ones.
+ * Threads outside the pool submit through a shared inbox. Workers are pinned one per allowed core and park on a
+ * condition variable after a few unsuccessful rounds of stealing.
+ *
+ * A worker in Task_group::sync() does not block while the group has work: it runs the group's tasks, and those of
+ * groups opened inside them, until the group is done. Nested spawns therefore reuse the same workers, and a parallel
+ * kernel called from inside another one neither creates threads nor oversubscribes the machine. Running nothing
+ * else keeps a waiting worker's stack as deep as the nesting of the parallel calls. A thread outside the pool hands
+ * its tasks to the workers and, after running its own share, sleeps in sync() until they are done.
+ */
+
+class Scheduler;
+
+class Task_group;
+
+//a unit of work. The deques store Task pointers; a task deletes itself after running.
+class Task {
+public:
+    explicit Task(Task_group *group = nullptr) : group(group) {}
+
+    virtual ~Task() = default;
+
+    virtual void run() = 0;
+
+    //whether the task belongs to `ancestor`, or to a group opened inside one of its tasks, at any depth.
+    [[nodiscard]] bool within(const Task_group *ancestor) const;
+
+protected:
+    Task_group *group;
+};
+
+//Chase-Lev work-stealing deque (Le, Pop, Cohen and Zappa Nardelli, PPoPP 2013). push() and take() may only be
+//called by the owner thread, steal() by any thread. Replaced arrays are kept until the deque is destroyed, since a
+//thief may still be reading one.
+class Work_deque {
+public:
+    explicit Work_deque(long capacity = 256) : array(new Ring(capacity)) {
+        retired.emplace_back(array.load(std::memory_order_relaxed));
+    }
+
+    Work_deque(const Work_deque &) = delete;
+
+    Work_deque &operator=(const Work_deque &) = delete;
+
+    void push(Task *task){
+        long b = bottom.load(std::memory_order_relaxed);
+        long t = top.load(std::memory_order_acquire);
+        Ring *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1){
+            a = grow(a, t, b);
+        }
+        a->put(b, task);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    //newest task, or nullptr when empty.
+    Task *take(){
+        long b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+        if (t > b){
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Task *task = a->get(b);
+        if (t == b){
+            //last task: race the thieves for it.
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    //oldest task, or nullptr when empty or when another thread won it.
+    Task *steal(){
+        long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = bottom.load(std::memory_order_acquire);
+        if (t >= b){
+            return nullptr;
+        }
+        Task *task = array.load(std::memory_order_acquire)->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+            return nullptr;
+        }
+        return task;
+    }
+
+    [[nodiscard]] bool empty() const{
+        return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring {
+        long capacity; //a power of two.
+        std::unique_ptr<std::atomic<Task *>[]> slots;
+
+        explicit Ring(long capacity) : capacity(capacity), slots(new std::atomic<Task *>[capacity]) {}
+
+        [[nodiscard]] Task *get(long i) const{ return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+
+        void put(long i, Task *task){ slots[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<long> top{0};
+    alignas(64) std::atomic<long> bottom{0};
+    std::atomic<Ring *> array;
+    std::vector<std::unique_ptr<Ring>> retired; //every Ring ever used, owned here; touched by the owner only.
+
+    Ring *grow(Ring *a, long t, long b){
+        auto bigger = new Ring(a->capacity * 2);
+        for (long i = t; i < b; i++){
+            bigger->put(i, a->get(i));
+        }
+        retired.emplace_back(bigger);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+};
+
+//tasks spawned together and waited for together. Must be synced before it is destroyed; the destructor does so.
+class Task_group {
+public:
+    explicit Task_group(Scheduler &scheduler);
+
+    Task_group();
+
+    Task_group(const Task_group &) = delete;
+
+    Task_group &operator=(const Task_group &) = delete;
+
+    ~Task_group(){
+        try{
+            sync();
+        }
+        catch (...){
+            //an exception nobody waited for has nowhere to go.
+        }
+    }
+
+    //runs f() on some worker, possibly the calling thread during sync().
+    template<class F>
+    void spawn(F &&f);
+
+    //returns once every spawned task has finished. On a worker it runs and steals tasks of this group meanwhile;
+    //outside the pool it sleeps. Rethrows the first exception a task threw.
+    void sync();
+
+private:
+    friend class Scheduler;
+
+    friend class Task;
+
+    template<class F>
+    friend class Group_task;
+
+    Scheduler &scheduler;
+    Task_group *const parent; //group of the task that opened this one, or nullptr.
+    const bool blocking; //opened outside the pool, so sync() sleeps on `done`.
+    std::atomic<long> pending{0};
+    std::mutex error_lock;
+    std::exception_ptr error;
+    std::mutex done_lock;
+    std::condition_variable done;
+
+    //group of the task the calling thread is running, or nullptr.
+    static Task_group *&running(){
+        static thread_local Task_group *group = nullptr;
+        return group;
+    }
+
+    void fail(std::exception_ptr e){
+        std::lock_guard<std::mutex> guard(error_lock);
+        if (!error){
+            error = std::move(e);
+        }
+    }
+
+    void finish(std::exception_ptr e){
+        if (e){
+            fail(std::move(e));
+        }
+        if (blocking){
+            //notify under the lock: sync() may return and destroy the group as soon as it gets the lock.
+            std::lock_guard<std::mutex> guard(done_lock);
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                done.notify_all();
+            }
+        }
+        else{
+            pending.fetch_sub(1, std::memory_order_acq_rel); //last touch of the group: sync() may return right after.
+        }
+    }
+};
+
+inline bool Task::within(const Task_group *ancestor) const{
+    for (auto g = group; g != nullptr; g = g->parent){
+        if (g == ancestor){
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class F>
+class Group_task : public Task {
+public:
+    Group_task(Task_group &group, F &&f) : Task(&group), f(std::forward<F>(f)) {}
+
+    void run() override{
+        std::exception_ptr e;
+        auto g = group;
+        auto outer = std::exchange(Task_group::running(), g);
+        try{
+            f();
+        }
+        catch (...){
+            e = std::current_exception();
+        }
+        Task_group::running() = outer;
+        delete this;
+        g->finish(std::move(e));
+    }
+
+private:
+    std::decay_t<F> f;
+};
+
+class Scheduler {
+public:
+    //the pool used when none is given: one thread per core this process may run on, the caller included.
+    static Scheduler &instance(){
+        static Scheduler scheduler(available_cores());
+        return scheduler;
+    }
+
+    //threads counts the calling thread, which runs its own share of parallel_for() and run_parallel(), so threads - 1
+    //workers are started.
+    explicit Scheduler(int threads) : deques(threads > 1 ? threads - 1 : 0) {
+        for (auto &deque: deques){
+            deque = std::make_unique<Work_deque>();
+        }
+        auto cores = allowed_cores();
+        for (int i = 0; i < static_cast<int>(deques.size()); i++){
+            workers.emplace_back([this, i]{ work(i); });
+            pin(workers.back(), cores.empty() ? -1 : cores[(i + 1) % cores.size()]);
+        }
+    }
+
+    Scheduler(const Scheduler &) = delete;
+
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    ~Scheduler(){
+        {
+            std::lock_guard<std::mutex> guard(park_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers){
+            worker.join();
+        }
+    }
+
+    //the calling thread included.
+    [[nodiscard]] int threads() const{ return static_cast<int>(deques.size()) + 1; }
+
+    //runs body(lo, hi) over [begin, end) cut into ranges of at most `grain` indices, splitting in halves so idle
+    //workers steal large ranges first. Returns when every range is done. The calling thread runs the first range
+    //itself, whether or not it is in the pool, so `threads()` threads work on the ranges.
+    template<class F>
+    void parallel_for(long begin, long end, long grain, const F &body){
+        if (grain < 1){
+            grain = 1;
+        }
+        if (end - begin <= grain || workers.empty()){
+            if (begin < end){
+                body(begin, end);
+            }
+            return;
+        }
+        Task_group group(*this);
+        split(group, begin, end, grain, body);
+        group.sync();
+    }
+
+private:
+    friend class Task_group;
+
+    static const int SPIN_ROUNDS = 64;
+
+    struct Current {
+        Scheduler *scheduler = nullptr;
+        int index = -1;
+    };
+
+    std::vector<std::unique_ptr<Work_deque>> deques;
+    std::vector<std::thread> workers;
+    std::mutex inbox_lock;
+    std::deque<Task *> inbox; //tasks spawned by threads outside the pool, taken oldest first.
+    std::atomic<long> inbox_size{0};
+    std::mutex park_lock;
+    std::condition_variable wake;
+    std::atomic<unsigned long> epoch{0}; //bumped on every spawn, so a worker about to park notices new work.
+    std::atomic<int> sleepers{0};
+    bool stopping = false;
+
+    static Current &current(){
+        static thread_local Current c;
+        return c;
+    }
+
+    static int available_cores(){
+        auto cores = allowed_cores();
+        if (!cores.empty()){
+            return static_cast<int>(cores.size());
+        }
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        return hardware > 0 ? hardware : 1;
+    }
+
+    static std::vector<int> allowed_cores(){
+        std::vector<int> cores;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0){
+            for (int c = 0; c < CPU_SETSIZE; c++){
+                if (CPU_ISSET(c, &set)){
+                    cores.push_back(c);
+                }
+            }
+        }
+#endif
+        return cores;
+    }
+
+    static void pin(std::thread &thread, int core){
+#ifdef __linux__
+        if (core >= 0){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set); //best effort.
+        }
+#endif
+    }
+
+    //deque index of the calling thread in this pool, or -1 for outside threads.
+    int self() const{
+        auto &c = current();
+        return c.scheduler == this ? c.index : -1;
+    }
+
+    void submit(Task *task){
+        int i = self();
+        if (i < 0){
+            post(task);
+            return;
+        }
+        deques[i]->push(task);
+        notify();
+    }
+
+    //queues task in the inbox, where any worker may take it.
+    void post(Task *task){
+        {
+            std::lock_guard<std::mutex> guard(inbox_lock);
+            inbox.push_back(task);
+            inbox_size.fetch_add(1, std::memory_order_release);
+        }
+        notify();
+    }
+
+    void notify(){
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0){
+            std::lock_guard<std::mutex> guard(park_lock);
+            wake.notify_one();
+        }
+    }
+
+    //a task for idle worker `i`: its own newest, then the inbox, then one stolen at random.
+    Task *find(int i, std::minstd_rand &random){
+        if (auto task = deques[i]->take()){
+            return task;
+        }
+        if (inbox_size.load(std::memory_order_acquire) > 0){
+            std::lock_guard<std::mutex> guard(inbox_lock);
+            if (!inbox.empty()){
+                Task *task = inbox.front();
+                inbox.pop_front();
+                inbox_size.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        int n = static_cast<int>(deques.size());
+        for (int k = 0, start = static_cast<int>(random() % n); k < n; k++){
+            int victim = (start + k) % n;
+            if (victim != i){
+                if (auto task = deques[victim]->steal()){
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void work(int i){
+        current() = Current{this, i};
+        std::minstd_rand random(i + 1);
+        while (true){
+            unsigned long seen = epoch.load(std::memory_order_seq_cst);
+            Task *task = nullptr;
+            for (int round = 0; round < SPIN_ROUNDS && task == nullptr; round++){
+                task = find(i, random);
+                if (task == nullptr){
+                    std::this_thread::yield();
+                }
+            }
+            if (task != nullptr){
+                task->run();
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(park_lock);
+            if (stopping){
+                return;
+            }
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            wake.wait(guard, [&]{ return stopping || epoch.load(std::memory_order_seq_cst) != seen; });
+            sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    //find() for worker `i` waiting on `group`, restricted to tasks within it. The bottom of the own deque is its
+    //newest task, so once that one is outside `group` every other one is too. A stolen task outside `group` goes to
+    //the inbox, where an idle worker or one waiting on its group picks it up.
+    Task *find_within(int i, std::minstd_rand &random, const Task_group &group){
+        if (auto task = deques[i]->take()){
+            if (task->within(&group)){
+                return task;
+            }
+            deques[i]->push(task);
+        }
+        if (inbox_size.load(std::memory_order_acquire) > 0){
+            std::lock_guard<std::mutex> guard(inbox_lock);
+            for (auto it = inbox.begin(); it != inbox.end(); ++it){
+                if ((*it)->within(&group)){
+                    Task *task = *it;
+                    inbox.erase(it);
+                    inbox_size.fetch_sub(1, std::memory_order_relaxed);
+                    return task;
+                }
+            }
+        }
+        int n = static_cast<int>(deques.size());
+        for (int k = 0, start = static_cast<int>(random() % n); k < n; k++){
+            int victim = (start + k) % n;
+            if (victim == i){
+                continue;
+            }
+            if (auto task = deques[victim]->steal()){
+                if (task->within(&group)){
+                    return task;
+                }
+                post(task);
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    //runs tasks within `group` on worker self() until `group` has none pending.
+    void help(Task_group &group){
+        int i = self();
+        thread_local std::minstd_rand random(std::random_device{}());
+        while (group.pending.load(std::memory_order_acquire) != 0){
+            if (auto task = find_within(i, random, group)){
+                task->run();
+            }
+            else{
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template<class F>
+    void split(Task_group &group, long begin, long end, long grain, const F &body){
+        while (end - begin > grain){
+            long mid = begin + (end - begin) / 2;
+            group.spawn([this, &group, mid, end, grain, &body]{ split(group, mid, end, grain, body); });
+            end = mid;
+        }
+        body(begin, end);
+    }
+};
+
+inline Task_group::Task_group(Scheduler &scheduler) :
+        scheduler(scheduler), parent(running()), blocking(scheduler.self() < 0) {}
+
+inline Task_group::Task_group() : Task_group(Scheduler::instance()) {}
+
+template<class F>
+void Task_group::spawn(F &&f){
+    if (scheduler.workers.empty()){
+        //no other thread could run it.
+        try{
+            f();
+        }
+        catch (...){
+            fail(std::current_exception());
+        }
+        return;
+    }
+    pending.fetch_add(1, std::memory_order_relaxed);
+    scheduler.submit(new Group_task<F>(*this, std::forward<F>(f)));
+}
+
+inline void Task_group::sync(){
+    if (blocking){
+        std::unique_lock<std::mutex> guard(done_lock);
+        done.wait(guard, [this]{ return pending.load(std::memory_order_acquire) == 0; });
+    }
+    else{
+        scheduler.help(*this);
+    }
+    std::lock_guard<std::mutex> guard(error_lock);
+    if (error){
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+#endif //DATA_STRUCTURES_SCHEDULER_H
@@ -2,6 +2,21 @@
 #include <vector>
 #include <iostream>
 #include<cstdlib>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <unistd.h>
+#include "trace.h"
+#include "scheduler.h"
 
 using std::vector;
 using std::endl;
@@ -9,6 +24,7 @@ using std::cout;
 using std::string;
 using std::ostream;
 using std::rand;
+using std::swap;
 
 template<typename T>
 using comparator = int (*)(const T &a, const T &b);
@@ -16,19 +32,13 @@ using comparator = int (*)(const T &a, const T &b);
 template<typename T>
 using viter = typename vector<T>::iterator;
 
-template<typename T>
-void swap(T &a, T &b) {
-    T temp = a;
-    a = b;
-    b = temp;
-}
 
 template<typename T>
 void bubble_sort(vector<T> &lst) {
     bool flag;
     do {
         flag = false;
-        for (int i = 0; i < lst.size() - 1; i++) {
+        for (size_t i = 0; i + 1 < lst.size(); i++) {
             if (lst[i + 1] < lst[i]) {
                 flag = true;
                 swap<T>(lst[i], lst[i + 1]);
@@ -39,8 +49,8 @@ void bubble_sort(vector<T> &lst) {
 
 template<typename T>
 void insertion_sort(vector<T> &lst, comparator<T> compare) {
-    for (int i = 0; i < lst.size(); i++) {
-        for (int j = i; j > 0; j--) {
+    for (size_t i = 0; i < lst.size(); i++) {
+        for (size_t j = i; j > 0; j--) {
             if (compare(lst[j - 1], lst[j]) > 0) {
                 swap(lst[j - 1], lst[j]);
             }
@@ -54,21 +64,23 @@ void merge(viter<T> start, viter<T> mid, viter<T> end, comparator<T> compare) {
      * Merges lst[start...end)
      * Requires lst[start...mid) and lst[mid...end) is sorted
      */
+    static Trace_site trace{"merge"};
     vector<T> temp{};
+    temp.reserve(end - start);
+    trace.allocate((end - start) * sizeof(T));
+    trace.moved(2 * (end - start));
     auto start1 = start;
     auto start2 = mid;
     while (start1 < mid || start2 < end) {
-        if (start1 == mid || (start2 != end && compare(*start1, *start2) >= 0)) {
-            temp.push_back(*start2);
+        if (start1 == mid || (start2 != end && compare(*start1, *start2) > 0)) {
+            temp.push_back(std::move(*start2));
             start2++;
         } else {
-            temp.push_back(*start1);
+            temp.push_back(std::move(*start1));
             start1++;
         }
     }
-    for (auto it1 = start, it2 = temp.begin(); it1 < end; it1++, it2++) {
-        *it1 = *it2;
-    }
+    std::move(temp.begin(), temp.end(), start);
 }
 
 template<typename T>
@@ -87,9 +99,124 @@ void merge_sort_aux(viter<T> start, viter<T> end, comparator<T> compare) {
 
 template<typename T>
 void merge_sort(vector<T> &lst, comparator<T> compare) {
+    static Trace_site trace{"merge_sort"};
+    auto timer = trace.time("sort");
     merge_sort_aux(lst.begin(), lst.end(), compare);
 }
 
+const int PARALLEL_SORT_CUTOFF = 1 << 14;
+
+int default_threads() {
+    return Scheduler::instance().threads();
+}
+
+template<typename F>
+void run_parallel(int threads, const F &task) {
+    /**
+     * Runs task(0) ... task(threads - 1) on the shared Scheduler, task(0) on the calling thread, and returns once
+     * all of them are done. The tasks may or may not run concurrently, so they must not wait for each other.
+     */
+    Task_group group;
+    for (int t = 1; t < threads; t++) {
+        group.spawn([&task, t]() { task(t); });
+    }
+    task(0);
+    group.sync();
+}
+
+template<typename T>
+long co_rank(long k, viter<T> a, long na, viter<T> b, long nb, comparator<T> compare) {
+    /**
+     * Number of elements taken from a[0...na) among the first k outputs of the stable merge of a and b,
+     * ties going to a.
+     */
+    long lo = k > nb ? k - nb : 0;
+    long hi = k < na ? k : na;
+    while (lo < hi) {
+        long i = lo + (hi - lo) / 2;
+        long j = k - i;
+        if (j > 0 && compare(*(b + (j - 1)), *(a + i)) >= 0) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+template<typename T>
+void parallel_merge(viter<T> start, viter<T> mid, viter<T> end, viter<T> out, comparator<T> compare,
+                    int threads) {
+    /**
+     * Stably merges lst[start...mid) and lst[mid...end) into out[0...end - start).
+     * The output is cut into equal slices; each thread finds where its slice begins in both inputs by co-rank
+     * and merges it independently.
+     */
+    long na = mid - start, nb = end - mid, n = na + nb;
+    run_parallel(threads, [&](int t) {
+        long k0 = n * t / threads, k1 = n * (t + 1) / threads;
+        long i0 = co_rank(k0, start, na, mid, nb, compare), i1 = co_rank(k1, start, na, mid, nb, compare);
+        auto a = start + i0, a_end = start + i1;
+        auto b = mid + (k0 - i0), b_end = mid + (k1 - i1);
+        auto o = out + k0;
+        while (a != a_end || b != b_end) {
+            if (a == a_end || (b != b_end && compare(*a, *b) > 0)) {
+                *o++ = std::move(*b++);
+            } else {
+                *o++ = std::move(*a++);
+            }
+        }
+    });
+}
+
+template<typename T>
+void parallel_merge_sort_aux(viter<T> start, viter<T> end, viter<T> scratch, comparator<T> compare, int threads) {
+    /**
+     * Merge sorts lst[start...end), spawning the left half as a task while threads remain.
+     * scratch must hold end - start elements.
+     */
+    if (threads <= 1 || end - start < PARALLEL_SORT_CUTOFF) {
+        merge_sort_aux<T>(start, end, compare);
+        return;
+    }
+    auto mid = start + (end - start) / 2;
+    int left = threads / 2;
+    Task_group group;
+    group.spawn([=]() { parallel_merge_sort_aux<T>(start, mid, scratch, compare, left); });
+    parallel_merge_sort_aux<T>(mid, end, scratch + (mid - start), compare, threads - left);
+    group.sync();
+    parallel_merge<T>(start, mid, end, scratch, compare, threads);
+    long n = end - start;
+    run_parallel(threads, [&](int t) {
+        std::move(scratch + n * t / threads, scratch + n * (t + 1) / threads, start + n * t / threads);
+    });
+}
+
+template<typename T>
+vector<T> scratch_buffer(const vector<T> &lst) {
+    /**
+     * Scratch vector the size of lst; a copy of it when T cannot be default constructed.
+     */
+    if constexpr (std::is_default_constructible_v<T>) {
+        return vector<T>(lst.size());
+    } else {
+        return vector<T>(lst);
+    }
+}
+
+template<typename T>
+void parallel_merge_sort(vector<T> &lst, comparator<T> compare, int threads = default_threads()) {
+    if (threads <= 1 || lst.size() < PARALLEL_SORT_CUTOFF) {
+        merge_sort(lst, compare);
+        return;
+    }
+    static Trace_site trace{"parallel_merge_sort"};
+    auto timer = trace.time("sort");
+    vector<T> scratch = scratch_buffer(lst);
+    trace.allocate(lst.size() * sizeof(T));
+    parallel_merge_sort_aux<T>(lst.begin(), lst.end(), scratch.begin(), compare, threads);
+}
+
 template<typename T>
 viter<T> partition(viter<T> begin, viter<T> end, comparator<T> compare) {
     /**
@@ -110,24 +237,1408 @@ viter<T> partition(viter<T> begin, viter<T> end, comparator<T> compare) {
     return i;
 }
 
+const int INSERTION_SORT_CUTOFF = 24;
+const int NINTHER_CUTOFF = 128;
+const int PARTITION_BLOCK = 64;
+
 template<typename T>
-void quick_sort_aux(viter<T> begin, viter<T> end, comparator<T> compare) {
+auto less_than(comparator<T> compare) {
     /**
-     * quick sorts lst[begin...end)
+     * Adapts a three-way comparator<T> to the strict "less" callable taken by the template sorts.
      */
-    if (begin == end || begin == end - 1) {
+    return [compare](const T &a, const T &b) { return compare(a, b) < 0; };
+}
+
+template<typename T, typename Less>
+void guarded_insertion_sort(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * Insertion sorts lst[begin...end), moving each element into place.
+     */
+    if (begin == end) {
         return;
     }
-    viter<T> pivot_pos = begin + (rand() % (end - begin));
-    swap(*pivot_pos, *begin);
-    pivot_pos = partition(begin, end, compare);
-    quick_sort_aux(begin, pivot_pos, compare);
-    quick_sort_aux(pivot_pos, end, compare);
+    for (auto i = begin + 1; i < end; i++) {
+        if (less(*i, *(i - 1))) {
+            T temp = std::move(*i);
+            auto j = i;
+            do {
+                *j = std::move(*(j - 1));
+                j--;
+            } while (j != begin && less(temp, *(j - 1)));
+            *j = std::move(temp);
+        }
+    }
+}
+
+template<typename T, typename Less>
+bool partial_insertion_sort(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * Insertion sorts lst[begin...end) unless that takes more than a handful of moves, in which case it gives up
+     * and returns false. Finishes nearly sorted ranges in linear time.
+     */
+    const int MOVE_LIMIT = 8;
+    if (begin == end) {
+        return true;
+    }
+    int moves = 0;
+    for (auto i = begin + 1; i < end; i++) {
+        if (less(*i, *(i - 1))) {
+            T temp = std::move(*i);
+            auto j = i;
+            do {
+                *j = std::move(*(j - 1));
+                j--;
+            } while (j != begin && less(temp, *(j - 1)));
+            *j = std::move(temp);
+            moves += i - j;
+        }
+        if (moves > MOVE_LIMIT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T, typename Less>
+void sift_down(viter<T> begin, long size, long i, Less &less) {
+    T temp = std::move(*(begin + i));
+    while (2 * i + 1 < size) {
+        long child = 2 * i + 1;
+        if (child + 1 < size && less(*(begin + child), *(begin + child + 1))) {
+            child++;
+        }
+        if (!less(temp, *(begin + child))) {
+            break;
+        }
+        *(begin + i) = std::move(*(begin + child));
+        i = child;
+    }
+    *(begin + i) = std::move(temp);
+}
+
+template<typename T, typename Less>
+void heap_sort(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * Heap sorts lst[begin...end). O(n log n) worst case, used when quick sort keeps partitioning badly.
+     */
+    long size = end - begin;
+    for (long i = size / 2 - 1; i >= 0; i--) {
+        sift_down<T>(begin, size, i, less);
+    }
+    for (long last = size - 1; last > 0; last--) {
+        std::iter_swap(begin, begin + last);
+        sift_down<T>(begin, last, 0, less);
+    }
+}
+
+template<typename T, typename Less>
+void sort3(viter<T> a, viter<T> b, viter<T> c, Less &less) {
+    if (less(*b, *a)) {
+        std::iter_swap(a, b);
+    }
+    if (less(*c, *b)) {
+        std::iter_swap(b, c);
+        if (less(*b, *a)) {
+            std::iter_swap(a, b);
+        }
+    }
+}
+
+template<typename T, typename Less>
+void block_partition(viter<T> &first, viter<T> &last, const T &pivot, Less &less) {
+    /**
+     * Branchless partitioning of lst[first...last) around pivot, narrowing the range it leaves unpartitioned.
+     * Each side records the offsets of its misplaced elements in a block with a data-dependent increment instead
+     * of a branch, then the recorded elements are swapped pairwise.
+     */
+    unsigned char offsets_l[PARTITION_BLOCK], offsets_r[PARTITION_BLOCK];
+    int num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+    while (last - first > 2 * PARTITION_BLOCK) {
+        if (num_l == 0) {
+            start_l = 0;
+            for (int i = 0; i < PARTITION_BLOCK; i++) {
+                offsets_l[num_l] = i;
+                num_l += !less(*(first + i), pivot);
+            }
+        }
+        if (num_r == 0) {
+            start_r = 0;
+            for (int i = 0; i < PARTITION_BLOCK; i++) {
+                offsets_r[num_r] = i;
+                num_r += less(*(last - 1 - i), pivot);
+            }
+        }
+        int num = std::min(num_l, num_r);
+        for (int k = 0; k < num; k++) {
+            std::iter_swap(first + offsets_l[start_l + k], last - 1 - offsets_r[start_r + k]);
+        }
+        num_l -= num;
+        num_r -= num;
+        start_l += num;
+        start_r += num;
+        if (num_l == 0) {
+            first += PARTITION_BLOCK;
+        }
+        if (num_r == 0) {
+            last -= PARTITION_BLOCK;
+        }
+    }
+}
+
+template<typename T, typename Less>
+std::pair<viter<T>, bool> partition_right(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * partitions lst[begin...end) into [< pivot | pivot | >= pivot] and returns the pivot position, and whether
+     * the range was already partitioned.
+     * requires: pivot placed at begin.
+     */
+    T pivot = std::move(*begin);
+    auto first = begin + 1;
+    auto last = end;
+    while (first < last && less(*first, pivot)) {
+        first++;
+    }
+    while (first < last && !less(*(last - 1), pivot)) {
+        last--;
+    }
+    bool already_partitioned = first >= last;
+    if constexpr (std::is_arithmetic_v<T>) {
+        block_partition<T>(first, last, pivot, less);
+    }
+    while (true) {
+        while (first < last && less(*first, pivot)) {
+            first++;
+        }
+        while (first < last && !less(*(last - 1), pivot)) {
+            last--;
+        }
+        if (first >= last) {
+            break;
+        }
+        std::iter_swap(first, --last);
+        first++;
+    }
+    auto pivot_pos = first - 1;
+    *begin = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return {pivot_pos, already_partitioned};
+}
+
+template<typename T, typename Less>
+viter<T> partition_left(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * partitions lst[begin...end) into [<= pivot | pivot | > pivot] and returns the pivot position.
+     * requires: pivot placed at begin.
+     */
+    T pivot = std::move(*begin);
+    auto first = begin + 1;
+    auto last = end;
+    while (true) {
+        while (first < last && !less(pivot, *first)) {
+            first++;
+        }
+        while (first < last && less(pivot, *(last - 1))) {
+            last--;
+        }
+        if (first >= last) {
+            break;
+        }
+        std::iter_swap(first, --last);
+        first++;
+    }
+    auto pivot_pos = first - 1;
+    *begin = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return pivot_pos;
+}
+
+template<typename T, typename Less>
+void intro_sort_aux(viter<T> begin, viter<T> end, Less &less, int bad_allowed, bool leftmost) {
+    /**
+     * Sorts lst[begin...end). Unless leftmost, lst[begin - 1] is the pivot of an enclosing partition and is
+     * no greater than any element of the range.
+     */
+    while (true) {
+        long size = end - begin;
+        if (size < INSERTION_SORT_CUTOFF) {
+            guarded_insertion_sort<T>(begin, end, less);
+            return;
+        }
+        auto mid = begin + size / 2;
+        if (size > NINTHER_CUTOFF) {
+            sort3<T>(begin, mid, end - 1, less);
+            sort3<T>(begin + 1, mid - 1, end - 2, less);
+            sort3<T>(begin + 2, mid + 1, end - 3, less);
+            sort3<T>(mid - 1, mid, mid + 1, less);
+            std::iter_swap(begin, mid);
+        } else {
+            sort3<T>(mid, begin, end - 1, less);
+        }
+        //a pivot equal to the enclosing pivot is the minimum of the range: its copies are done, skip them.
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = partition_left<T>(begin, end, less) + 1;
+            continue;
+        }
+        auto [pivot_pos, already_partitioned] = partition_right<T>(begin, end, less);
+        long l_size = pivot_pos - begin;
+        long r_size = end - (pivot_pos + 1);
+        if (l_size < size / 8 || r_size < size / 8) {
+            //unbalanced: give up on quick sort after too many, otherwise shuffle a few elements to break patterns.
+            if (--bad_allowed == 0) {
+                heap_sort<T>(begin, end, less);
+                return;
+            }
+            if (l_size >= INSERTION_SORT_CUTOFF) {
+                std::iter_swap(begin, begin + l_size / 4);
+                std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+            }
+            if (r_size >= INSERTION_SORT_CUTOFF) {
+                std::iter_swap(pivot_pos + 1, pivot_pos + 1 + r_size / 4);
+                std::iter_swap(end - 1, end - r_size / 4);
+            }
+        } else if (already_partitioned && partial_insertion_sort<T>(begin, pivot_pos, less)
+                   && partial_insertion_sort<T>(pivot_pos + 1, end, less)) {
+            return;
+        }
+        //recurse into the smaller side and loop on the larger one, bounding the stack to O(log n).
+        if (l_size < r_size) {
+            intro_sort_aux<T>(begin, pivot_pos, less, bad_allowed, leftmost);
+            begin = pivot_pos + 1;
+            leftmost = false;
+        } else {
+            intro_sort_aux<T>(pivot_pos + 1, end, less, bad_allowed, false);
+            end = pivot_pos;
+        }
+    }
+}
+
+template<typename T, typename Less>
+void intro_sort(viter<T> begin, viter<T> end, Less less) {
+    /**
+     * Sorts lst[begin...end) by less, any callable strict weak ordering, so the comparison can be inlined.
+     * Quick sort with median-of-three (ninther above NINTHER_CUTOFF) pivots, insertion sort below
+     * INSERTION_SORT_CUTOFF, duplicate-skipping partitions and a heap sort fallback after log2(n) unbalanced
+     * partitions, so O(n log n) worst case.
+     */
+    int log2 = 0;
+    for (auto size = end - begin; size > 1; size >>= 1) {
+        log2++;
+    }
+    intro_sort_aux<T>(begin, end, less, log2 + 1, true);
+}
+
+template<typename T, typename Less = std::less<T>>
+void intro_sort(vector<T> &lst, Less less = Less()) {
+    static Trace_site trace{"intro_sort"};
+    auto timer = trace.time("sort");
+    intro_sort<T>(lst.begin(), lst.end(), less);
 }
 
 template<typename T>
 void quick_sort(vector<T> &lst, comparator<T> compare) {
-    quick_sort_aux(lst.begin(), lst.end(), compare);
+    static Trace_site trace{"quick_sort"};
+    auto timer = trace.time("sort");
+    intro_sort<T>(lst.begin(), lst.end(), less_than<T>(compare));
+}
+
+template<typename T, typename P>
+viter<T> parallel_partition(viter<T> begin, viter<T> end, const P &pred, int threads) {
+    /**
+     * Reorders lst[begin...end) so elements satisfying pred come first and returns the boundary.
+     * Each thread partitions its own block; the elements left on the wrong side of the global boundary are then
+     * swapped pairwise, again split evenly between threads.
+     */
+    long n = end - begin;
+    vector<long> bound(threads + 1), split(threads);
+    for (int t = 0; t <= threads; t++) {
+        bound[t] = n * t / threads;
+    }
+    run_parallel(threads, [&](int t) {
+        split[t] = std::partition(begin + bound[t], begin + bound[t + 1], pred) - begin;
+    });
+    long boundary = 0;
+    for (int t = 0; t < threads; t++) {
+        boundary += split[t] - bound[t];
+    }
+    //misplaced runs: failing elements before the boundary and passing elements after it.
+    vector<std::pair<long, long>> wrong_left, wrong_right;
+    for (int t = 0; t < threads; t++) {
+        if (split[t] < std::min(bound[t + 1], boundary)) {
+            wrong_left.emplace_back(split[t], std::min(bound[t + 1], boundary));
+        }
+        if (std::max(bound[t], boundary) < split[t]) {
+            wrong_right.emplace_back(std::max(bound[t], boundary), split[t]);
+        }
+    }
+    long misplaced = 0;
+    for (auto &run: wrong_left) {
+        misplaced += run.second - run.first;
+    }
+    run_parallel(threads, [&](int t) {
+        long k = misplaced * t / threads, k_end = misplaced * (t + 1) / threads;
+        size_t l = 0, r = 0;
+        long l_pos = wrong_left.empty() ? 0 : wrong_left[0].first;
+        long r_pos = wrong_right.empty() ? 0 : wrong_right[0].first;
+        for (long skip = k; skip > 0;) {
+            long step = std::min(skip, wrong_left[l].second - l_pos);
+            l_pos += step;
+            skip -= step;
+            if (l_pos == wrong_left[l].second && ++l < wrong_left.size()) {
+                l_pos = wrong_left[l].first;
+            }
+        }
+        for (long skip = k; skip > 0;) {
+            long step = std::min(skip, wrong_right[r].second - r_pos);
+            r_pos += step;
+            skip -= step;
+            if (r_pos == wrong_right[r].second && ++r < wrong_right.size()) {
+                r_pos = wrong_right[r].first;
+            }
+        }
+        for (; k < k_end; k++) {
+            std::iter_swap(begin + l_pos, begin + r_pos);
+            if (++l_pos == wrong_left[l].second && ++l < wrong_left.size()) {
+                l_pos = wrong_left[l].first;
+            }
+            if (++r_pos == wrong_right[r].second && ++r < wrong_right.size()) {
+                r_pos = wrong_right[r].first;
+            }
+        }
+    });
+    return begin + boundary;
+}
+
+template<typename T, typename Less>
+void parallel_quick_sort_aux(viter<T> begin, viter<T> end, Less &less, int threads) {
+    /**
+     * quick sorts lst[begin...end), partitioning in parallel blocks into [< pivot | == pivot | > pivot] and
+     * spawning the lower side as a task while threads remain.
+     */
+    if (threads <= 1 || end - begin < PARALLEL_SORT_CUTOFF) {
+        intro_sort<T>(begin, end, less);
+        return;
+    }
+    //Tukey's ninther, as in intro_sort_aux: no shared random state between concurrent tasks.
+    auto mid = begin + (end - begin) / 2;
+    sort3<T>(begin, mid, end - 1, less);
+    sort3<T>(begin + 1, mid - 1, end - 2, less);
+    sort3<T>(begin + 2, mid + 1, end - 3, less);
+    sort3<T>(mid - 1, mid, mid + 1, less);
+    T pivot = *mid;
+    auto lt = parallel_partition<T>(begin, end, [&](const T &x) { return less(x, pivot); }, threads);
+    auto gt = parallel_partition<T>(lt, end, [&](const T &x) { return !less(pivot, x); }, threads);
+    int left = threads / 2;
+    Task_group group;
+    group.spawn([=, &less]() { parallel_quick_sort_aux<T>(begin, lt, less, left); });
+    parallel_quick_sort_aux<T>(gt, end, less, threads - left);
+    group.sync();
+}
+
+template<typename T>
+void parallel_quick_sort(vector<T> &lst, comparator<T> compare, int threads = default_threads()) {
+    static Trace_site trace{"parallel_quick_sort"};
+    auto timer = trace.time("sort");
+    auto less = less_than<T>(compare);
+    parallel_quick_sort_aux<T>(lst.begin(), lst.end(), less, threads);
+}
+
+template<typename T>
+void select_aux(viter<T> begin, viter<T> nth, viter<T> end, comparator<T> compare, int depth) {
+    /**
+     * Introselect: rearranges lst[begin...end) so *nth is the element a full sort would put there, with no greater
+     * element before it and no smaller one after. Quick select with median-of-three pivots, falling back to heap
+     * sort once depth runs out.
+     */
+    auto less = less_than<T>(compare);
+    while (end - begin > INSERTION_SORT_CUTOFF) {
+        if (depth-- == 0) {
+            heap_sort<T>(begin, end, less);
+            return;
+        }
+        auto mid = begin + (end - begin) / 2;
+        sort3<T>(mid, begin, end - 1, less);
+        auto pivot_pos = partition<T>(begin, end, compare);
+        if (pivot_pos == nth) {
+            return;
+        }
+        if (nth > pivot_pos) {
+            begin = pivot_pos + 1;
+            continue;
+        }
+        //partition() sends keys equal to the pivot left; on a lopsided split set them aside before going on.
+        if (pivot_pos - begin > 3 * (end - begin) / 4) {
+            auto equal = std::partition(begin, pivot_pos, [&](const T &x) { return less(x, *pivot_pos); });
+            if (nth >= equal) {
+                return;
+            }
+            end = equal;
+        } else {
+            end = pivot_pos;
+        }
+    }
+    guarded_insertion_sort<T>(begin, end, less);
+}
+
+template<typename T>
+void nth_element(vector<T> &lst, int nth, comparator<T> compare) {
+    /**
+     * Places the element of rank nth at lst[nth], smaller or equal ones before it and greater or equal ones after.
+     * O(n) expected, O(n log n) worst case.
+     */
+    if (nth < 0 || static_cast<size_t>(nth) >= lst.size()) {
+        return;
+    }
+    int log2 = 0;
+    for (auto size = lst.size(); size > 1; size >>= 1) {
+        log2++;
+    }
+    select_aux<T>(lst.begin(), lst.begin() + nth, lst.end(), compare, 2 * log2);
+}
+
+template<typename T>
+void partial_sort(vector<T> &lst, int k, comparator<T> compare) {
+    /**
+     * Puts the k smallest elements, sorted, at lst[0...k); the rest follow in unspecified order.
+     * O(n + k log k).
+     */
+    if (k <= 0) {
+        return;
+    }
+    if (static_cast<size_t>(k) < lst.size()) {
+        nth_element(lst, k - 1, compare);
+    }
+    intro_sort<T>(lst.begin(), lst.begin() + std::min<size_t>(k, lst.size()), less_than<T>(compare));
+}
+
+template<typename T>
+class Top_k {
+    /**
+     * Streaming accumulator of the k smallest elements under compare. Keeps them in a max-heap of size k, so
+     * each push is O(log k) and items that cannot make the cut cost one comparison.
+     */
+private:
+    int k;
+    comparator<T> compare;
+    vector<T> heap;
+
+    void sift_up(int i) {
+        T temp = std::move(heap[i]);
+        while (i > 0 && compare(heap[(i - 1) / 2], temp) < 0) {
+            heap[i] = std::move(heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        heap[i] = std::move(temp);
+    }
+
+public:
+    Top_k(int k, comparator<T> compare) : k(k), compare(compare) {
+        heap.reserve(k > 0 ? k : 0);
+    }
+
+    void push(T item) {
+        if (static_cast<long>(heap.size()) < k) {
+            heap.push_back(std::move(item));
+            sift_up(heap.size() - 1);
+        } else if (k > 0 && compare(item, heap[0]) < 0) {
+            heap[0] = std::move(item);
+            auto less = less_than<T>(compare);
+            sift_down<T>(heap.begin(), heap.size(), 0, less);
+        }
+    }
+
+    [[nodiscard]] int get_size() const { return heap.size(); }
+
+    [[nodiscard]] vector<T> result() const {
+        /**
+         * The elements kept so far, in ascending order.
+         */
+        vector<T> sorted{heap};
+        intro_sort<T>(sorted.begin(), sorted.end(), less_than<T>(compare));
+        return sorted;
+    }
+};
+
+const int MIN_MERGE = 64;
+const int MIN_GALLOP = 7;
+
+template<typename T, typename Less>
+long gallop_upper(const T &key, viter<T> first, long size, Less &less) {
+    /**
+     * Number of elements of sorted lst[first...first + size) that are <= key, by exponential then binary search
+     * from the left.
+     */
+    long lo = 0, hi = 1;
+    while (hi <= size && !less(key, *(first + (hi - 1)))) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    return std::upper_bound(first + lo, first + std::min(hi, size), key, less) - first;
+}
+
+template<typename T, typename Less>
+long gallop_lower(const T &key, viter<T> first, long size, Less &less) {
+    /**
+     * Number of elements of sorted lst[first...first + size) that are < key, searching from the left.
+     */
+    long lo = 0, hi = 1;
+    while (hi <= size && less(*(first + (hi - 1)), key)) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    return std::lower_bound(first + lo, first + std::min(hi, size), key, less) - first;
+}
+
+template<typename T, typename Less>
+long gallop_upper_right(const T &key, viter<T> first, long size, Less &less) {
+    /**
+     * Number of elements of sorted lst[first...first + size) that are <= key, searching from the right.
+     */
+    long last = 0, ofs = 1;
+    while (ofs <= size && less(key, *(first + (size - ofs)))) {
+        last = ofs;
+        ofs = 2 * ofs + 1;
+    }
+    long lo = ofs <= size ? size - ofs + 1 : 0;
+    return std::upper_bound(first + lo, first + (size - last), key, less) - first;
+}
+
+template<typename T, typename Less>
+long gallop_lower_right(const T &key, viter<T> first, long size, Less &less) {
+    /**
+     * Number of elements of sorted lst[first...first + size) that are < key, searching from the right.
+     */
+    long last = 0, ofs = 1;
+    while (ofs <= size && !less(*(first + (size - ofs)), key)) {
+        last = ofs;
+        ofs = 2 * ofs + 1;
+    }
+    long lo = ofs <= size ? size - ofs + 1 : 0;
+    return std::lower_bound(first + lo, first + (size - last), key, less) - first;
+}
+
+template<typename T, typename Less>
+void merge_lo(viter<T> base1, long len1, viter<T> base2, long len2, vector<T> &buffer, Less &less) {
+    /**
+     * Stably merges adjacent runs lst[base1...base1 + len1) and lst[base2...base2 + len2), len1 <= len2.
+     * The left run is moved into buffer and the result is written from the left. After MIN_GALLOP consecutive
+     * wins by one run, whole stretches of it are found by galloping and moved at once.
+     */
+    buffer.clear();
+    buffer.insert(buffer.end(), std::make_move_iterator(base1), std::make_move_iterator(base1 + len1));
+    auto a = buffer.begin(), a_end = buffer.end();
+    auto b = base2, b_end = base2 + len2;
+    auto dest = base1;
+    while (a != a_end && b != b_end) {
+        int count_a = 0, count_b = 0;
+        do {
+            if (less(*b, *a)) {
+                *dest++ = std::move(*b++);
+                count_b++;
+                count_a = 0;
+            } else {
+                *dest++ = std::move(*a++);
+                count_a++;
+                count_b = 0;
+            }
+        } while (a != a_end && b != b_end && count_a < MIN_GALLOP && count_b < MIN_GALLOP);
+        long k_a = MIN_GALLOP, k_b = MIN_GALLOP;
+        while (a != a_end && b != b_end && (k_a >= MIN_GALLOP || k_b >= MIN_GALLOP)) {
+            k_a = gallop_upper<T>(*b, a, a_end - a, less);
+            dest = std::move(a, a + k_a, dest);
+            a += k_a;
+            if (a == a_end) {
+                break;
+            }
+            *dest++ = std::move(*b++);
+            if (b == b_end) {
+                break;
+            }
+            k_b = gallop_lower<T>(*a, b, b_end - b, less);
+            dest = std::move(b, b + k_b, dest);
+            b += k_b;
+            if (b == b_end) {
+                break;
+            }
+            *dest++ = std::move(*a++);
+        }
+    }
+    std::move(a, a_end, dest);
+}
+
+template<typename T, typename Less>
+void merge_hi(viter<T> base1, long len1, viter<T> base2, long len2, vector<T> &buffer, Less &less) {
+    /**
+     * merge_lo mirrored for len1 > len2: the right run is moved into buffer and the result is written from the
+     * right.
+     */
+    buffer.clear();
+    buffer.insert(buffer.end(), std::make_move_iterator(base2), std::make_move_iterator(base2 + len2));
+    auto a = base1 + len1;
+    auto b = buffer.end(), b_begin = buffer.begin();
+    auto dest = base2 + len2;
+    while (a != base1 && b != b_begin) {
+        int count_a = 0, count_b = 0;
+        do {
+            if (less(*(b - 1), *(a - 1))) {
+                *--dest = std::move(*--a);
+                count_a++;
+                count_b = 0;
+            } else {
+                *--dest = std::move(*--b);
+                count_b++;
+                count_a = 0;
+            }
+        } while (a != base1 && b != b_begin && count_a < MIN_GALLOP && count_b < MIN_GALLOP);
+        long k_a = MIN_GALLOP, k_b = MIN_GALLOP;
+        while (a != base1 && b != b_begin && (k_a >= MIN_GALLOP || k_b >= MIN_GALLOP)) {
+            auto keep = gallop_upper_right<T>(*(b - 1), base1, a - base1, less);
+            k_a = (a - base1) - keep;
+            dest = std::move_backward(base1 + keep, a, dest);
+            a = base1 + keep;
+            if (a == base1) {
+                break;
+            }
+            *--dest = std::move(*--b);
+            if (b == b_begin) {
+                break;
+            }
+            keep = gallop_lower_right<T>(*(a - 1), b_begin, b - b_begin, less);
+            k_b = (b - b_begin) - keep;
+            dest = std::move_backward(b_begin + keep, b, dest);
+            b = b_begin + keep;
+            if (b == b_begin) {
+                break;
+            }
+            *--dest = std::move(*--a);
+        }
+    }
+    std::move_backward(b_begin, b, dest);
+}
+
+template<typename T, typename Less>
+void merge_runs(viter<T> base1, long len1, viter<T> base2, long len2, vector<T> &buffer, Less &less) {
+    /**
+     * Merges adjacent sorted runs, first trimming the prefix of the left run and the suffix of the right run that
+     * are already in place.
+     */
+    long k = gallop_upper<T>(*base2, base1, len1, less);
+    base1 += k;
+    len1 -= k;
+    if (len1 == 0) {
+        return;
+    }
+    len2 = gallop_lower_right<T>(*(base1 + (len1 - 1)), base2, len2, less);
+    if (len2 == 0) {
+        return;
+    }
+    if (len1 <= len2) {
+        merge_lo<T>(base1, len1, base2, len2, buffer, less);
+    } else {
+        merge_hi<T>(base1, len1, base2, len2, buffer, less);
+    }
+}
+
+template<typename T, typename Less>
+void binary_insertion_sort(viter<T> begin, viter<T> sorted, viter<T> end, Less &less) {
+    /**
+     * Stably sorts lst[begin...end) given lst[begin...sorted) is sorted.
+     */
+    for (auto i = sorted; i < end; i++) {
+        auto pos = std::upper_bound(begin, i, *i, less);
+        if (pos != i) {
+            T temp = std::move(*i);
+            std::move_backward(pos, i, i + 1);
+            *pos = std::move(temp);
+        }
+    }
+}
+
+template<typename T, typename Less>
+viter<T> natural_run(viter<T> begin, viter<T> end, Less &less) {
+    /**
+     * Returns the end of the run starting at begin, reversing it first if it is strictly descending.
+     */
+    auto run_end = begin + 1;
+    if (run_end == end) {
+        return end;
+    }
+    if (less(*run_end, *begin)) {
+        while (run_end != end && less(*run_end, *(run_end - 1))) {
+            run_end++;
+        }
+        std::reverse(begin, run_end);
+    } else {
+        while (run_end != end && !less(*run_end, *(run_end - 1))) {
+            run_end++;
+        }
+    }
+    return run_end;
+}
+
+template<typename T, typename Less>
+void tim_sort(viter<T> begin, viter<T> end, Less less) {
+    /**
+     * Stable adaptive merge sort of lst[begin...end) by less. Splits the input into natural runs, extending short
+     * ones to a minimum length by binary insertion sort, and merges them under the TimSort stack invariants so
+     * merges stay balanced. Sorted or reversed input is a single run, so O(n).
+     */
+    static Trace_site trace{"tim_sort"};
+    auto timer = trace.time("sort");
+    long size = end - begin;
+    if (size < 2) {
+        return;
+    }
+    long min_run = size, extra = 0;
+    while (min_run >= MIN_MERGE) {
+        extra |= min_run & 1;
+        min_run >>= 1;
+    }
+    min_run += extra;
+    vector<T> buffer;
+    buffer.reserve(size / 2 + 1);
+    trace.allocate((size / 2 + 1) * sizeof(T));
+    vector<std::pair<viter<T>, long>> runs;
+    for (auto start = begin; start != end;) {
+        auto run_end = natural_run<T>(start, end, less);
+        if (run_end - start < min_run) {
+            auto forced_end = start + std::min(min_run, static_cast<long>(end - start));
+            binary_insertion_sort<T>(start, run_end, forced_end, less);
+            run_end = forced_end;
+        }
+        runs.emplace_back(start, run_end - start);
+        start = run_end;
+        //restore |Z| > |Y| + |X| and |Y| > |X| for the top runs X, Y, Z (top to bottom).
+        while (runs.size() > 1) {
+            long n = static_cast<long>(runs.size()) - 2;
+            if ((n > 0 && runs[n - 1].second <= runs[n].second + runs[n + 1].second)
+                || (n > 1 && runs[n - 2].second <= runs[n - 1].second + runs[n].second)) {
+                if (runs[n - 1].second < runs[n + 1].second) {
+                    n--;
+                }
+            } else if (runs[n].second > runs[n + 1].second) {
+                break;
+            }
+            merge_runs<T>(runs[n].first, runs[n].second, runs[n + 1].first, runs[n + 1].second, buffer, less);
+            runs[n].second += runs[n + 1].second;
+            runs.erase(runs.begin() + n + 1);
+        }
+    }
+    while (runs.size() > 1) {
+        long n = static_cast<long>(runs.size()) - 2;
+        if (n > 0 && runs[n - 1].second < runs[n + 1].second) {
+            n--;
+        }
+        merge_runs<T>(runs[n].first, runs[n].second, runs[n + 1].first, runs[n + 1].second, buffer, less);
+        runs[n].second += runs[n + 1].second;
+        runs.erase(runs.begin() + n + 1);
+    }
+}
+
+template<typename T, typename Less = std::less<T>>
+void tim_sort(vector<T> &lst, Less less = Less()) {
+    tim_sort<T>(lst.begin(), lst.end(), less);
+}
+
+template<typename T>
+void tim_sort(vector<T> &lst, comparator<T> compare) {
+    tim_sort<T>(lst.begin(), lst.end(), less_than<T>(compare));
+}
+
+const int RADIX_BITS = 8;
+const int RADIX = 1 << RADIX_BITS;
+
+template<typename K>
+auto radix_key(K k) {
+    /**
+     * Maps an arithmetic key to an unsigned integer with the same order: the sign bit of signed integers is
+     * flipped, negative IEEE floats have all bits flipped and positive ones only the sign bit.
+     */
+    static_assert(std::is_arithmetic_v<K>, "radix sort keys must be arithmetic");
+    if constexpr (std::is_floating_point_v<K>) {
+        using U = std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>;
+        static_assert(sizeof(K) == sizeof(U), "radix sort supports float and double keys");
+        U u;
+        std::memcpy(&u, &k, sizeof(u));
+        const U SIGN = U(1) << (sizeof(U) * 8 - 1);
+        return u & SIGN ? U(~u) : U(u | SIGN);
+    } else {
+        using U = std::make_unsigned_t<K>;
+        auto u = static_cast<U>(k);
+        if constexpr (std::is_signed_v<K>) {
+            u ^= U(1) << (sizeof(U) * 8 - 1);
+        }
+        return u;
+    }
+}
+
+template<typename T, typename Key>
+void radix_sort(vector<T> &lst, Key key) {
+    /**
+     * Stable LSD radix sort of lst by key(x), an arithmetic value, one RADIX_BITS digit per pass.
+     * The histograms of all digits are counted in one pass over the input, and digits on which every key agrees
+     * are skipped.
+     */
+    static Trace_site trace{"radix_sort"};
+    auto timer = trace.time("sort");
+    using U = decltype(radix_key(key(std::declval<const T &>())));
+    const int PASSES = (sizeof(U) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+    size_t n = lst.size();
+    if (n < 2) {
+        return;
+    }
+    vector<std::array<size_t, RADIX>> count(PASSES);
+    for (auto &c: count) {
+        c.fill(0);
+    }
+    for (auto &x: lst) {
+        U u = radix_key(key(x));
+        for (int p = 0; p < PASSES; p++) {
+            count[p][(u >> (p * RADIX_BITS)) & (RADIX - 1)]++;
+        }
+    }
+    vector<T> buffer = scratch_buffer(lst);
+    trace.allocate(n * sizeof(T));
+    vector<T> *src = &lst, *dst = &buffer;
+    U first = radix_key(key(lst[0])); //read before any pass moves lst[0] out.
+    for (int p = 0; p < PASSES; p++) {
+        int shift = p * RADIX_BITS;
+        if (count[p][(first >> shift) & (RADIX - 1)] == n) {
+            continue;
+        }
+        trace.moved(static_cast<long>(n));
+        std::array<size_t, RADIX> offset{};
+        for (int d = 1; d < RADIX; d++) {
+            offset[d] = offset[d - 1] + count[p][d - 1];
+        }
+        for (auto &x: *src) {
+            (*dst)[offset[(radix_key(key(x)) >> shift) & (RADIX - 1)]++] = std::move(x);
+        }
+        std::swap(src, dst);
+    }
+    if (src != &lst) {
+        lst.swap(buffer);
+    }
+}
+
+template<typename T>
+void radix_sort(vector<T> &lst) {
+    radix_sort(lst, [](const T &x) { return x; });
+}
+
+template<typename T, typename Key>
+void parallel_radix_sort(vector<T> &lst, Key key, int threads = default_threads()) {
+    /**
+     * radix_sort with each pass split between threads: every thread counts the digits of its own slice, the
+     * per-thread histograms are laid out bucket-major so thread t writes bucket d right after threads 0...t-1,
+     * and then every thread scatters its slice. Slices keep their order, so the sort stays stable.
+     */
+    if (threads <= 1 || lst.size() < PARALLEL_SORT_CUTOFF) {
+        radix_sort(lst, key);
+        return;
+    }
+    static Trace_site trace{"parallel_radix_sort"};
+    auto timer = trace.time("sort");
+    using U = decltype(radix_key(key(std::declval<const T &>())));
+    const int PASSES = (sizeof(U) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+    size_t n = lst.size();
+    vector<vector<std::array<size_t, RADIX>>> count(threads, vector<std::array<size_t, RADIX>>(PASSES));
+    run_parallel(threads, [&](int t) {
+        for (auto &c: count[t]) {
+            c.fill(0);
+        }
+        for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+            U u = radix_key(key(lst[i]));
+            for (int p = 0; p < PASSES; p++) {
+                count[t][p][(u >> (p * RADIX_BITS)) & (RADIX - 1)]++;
+            }
+        }
+    });
+    U first = radix_key(key(lst[0]));
+    vector<T> buffer = scratch_buffer(lst);
+    trace.allocate(n * sizeof(T));
+    vector<T> *src = &lst, *dst = &buffer;
+    vector<std::array<size_t, RADIX>> offset(threads);
+    bool scattered = false;
+    for (int p = 0; p < PASSES; p++) {
+        int shift = p * RADIX_BITS;
+        size_t same = 0;
+        for (int t = 0; t < threads; t++) {
+            same += count[t][p][(first >> shift) & (RADIX - 1)];
+        }
+        if (same == n) {
+            continue;
+        }
+        //the all-digit counts above describe the original slices; after a scatter they must be recounted.
+        if (scattered) {
+            run_parallel(threads, [&](int t) {
+                count[t][p].fill(0);
+                for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+                    count[t][p][(radix_key(key((*src)[i])) >> shift) & (RADIX - 1)]++;
+                }
+            });
+        }
+        size_t total = 0;
+        for (int d = 0; d < RADIX; d++) {
+            for (int t = 0; t < threads; t++) {
+                offset[t][d] = total;
+                total += count[t][p][d];
+            }
+        }
+        run_parallel(threads, [&](int t) {
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+                (*dst)[offset[t][(radix_key(key((*src)[i])) >> shift) & (RADIX - 1)]++] = std::move((*src)[i]);
+            }
+        });
+        trace.moved(static_cast<long>(n));
+        std::swap(src, dst);
+        scattered = true;
+    }
+    if (src != &lst) {
+        lst.swap(buffer);
+    }
+}
+
+template<typename T>
+void parallel_radix_sort(vector<T> &lst, int threads = default_threads()) {
+    parallel_radix_sort(lst, [](const T &x) { return x; }, threads);
+}
+
+template<typename T, typename Key, typename I>
+vector<size_t> sort_permutation_aux(const vector<T> &lst, Key &key) {
+    using K = std::decay_t<decltype(key(std::declval<const T &>()))>;
+    struct Tagged {
+        K key;
+        I index;
+    };
+    vector<Tagged> tags(lst.size());
+    for (size_t i = 0; i < lst.size(); i++) {
+        tags[i] = Tagged{key(lst[i]), static_cast<I>(i)};
+    }
+    radix_sort(tags, [](const Tagged &tag) { return tag.key; });
+    vector<size_t> perm(lst.size());
+    for (size_t i = 0; i < tags.size(); i++) {
+        perm[i] = tags[i].index;
+    }
+    return perm;
+}
+
+template<typename T, typename Key>
+vector<size_t> sort_permutation(const vector<T> &lst, Key key) {
+    /**
+     * The stable sorting permutation of lst by key(x), an arithmetic value: lst[perm[0]], lst[perm[1]], ... is
+     * sorted. Only compact (key, index) pairs are sorted, with radix_sort; lst itself is not touched.
+     */
+    if (lst.size() <= UINT32_MAX) {
+        return sort_permutation_aux<T, Key, uint32_t>(lst, key);
+    }
+    return sort_permutation_aux<T, Key, size_t>(lst, key);
+}
+
+template<typename T>
+void apply_permutation(vector<T> &lst, vector<size_t> perm) {
+    /**
+     * Rearranges lst in place so the new lst[i] is the old lst[perm[i]], following each cycle of perm once.
+     * Every element is moved once, plus one extra move per cycle.
+     */
+    for (size_t i = 0; i < perm.size(); i++) {
+        if (perm[i] == i) {
+            continue;
+        }
+        T temp = std::move(lst[i]);
+        size_t j = i;
+        while (perm[j] != i) {
+            size_t next = perm[j];
+            lst[j] = std::move(lst[next]);
+            perm[j] = j;
+            j = next;
+        }
+        lst[j] = std::move(temp);
+        perm[j] = j;
+    }
+}
+
+template<typename T>
+vector<T> gather(vector<T> &lst, const vector<size_t> &perm) {
+    /**
+     * Moves lst[perm[0]], lst[perm[1]], ... into a new vector, leaving lst moved-from.
+     */
+    vector<T> result;
+    result.reserve(perm.size());
+    for (auto i: perm) {
+        result.push_back(std::move(lst[i]));
+    }
+    return result;
+}
+
+template<typename T, typename Key>
+void tagged_sort(vector<T> &lst, Key key) {
+    /**
+     * Stable sort of records with heavy payloads by an arithmetic key: sorts (key, index) pairs, then moves each
+     * record into place once.
+     */
+    static Trace_site trace{"tagged_sort"};
+    auto timer = trace.time("sort");
+    trace.moved(static_cast<long>(lst.size()));
+    apply_permutation(lst, sort_permutation(lst, key));
+}
+
+struct External_sort_config {
+    size_t memory_limit = size_t(1) << 30; //bytes of records and I/O buffers held at once.
+    size_t block_size = size_t(1) << 22; //bytes per read or write request. open runs hold two blocks each.
+    string temp_dir = "/tmp";
+    int threads = default_threads();
+};
+
+template<typename Beats>
+class Loser_tree {
+    /**
+     * Tournament tree over k sources for k-way merging. Internal nodes keep the loser of the match played there,
+     * so after the winner advances, replay() walks one leaf-to-root path: log2(k) comparisons, no swaps.
+     * beats(a, b) tells whether source a's head goes before source b's.
+     */
+private:
+    int k;
+    vector<int> tree; //tree[0] is the overall winner, tree[1...k) the losers.
+    Beats beats;
+
+    int build(int node) {
+        if (node >= k) {
+            return node - k;
+        }
+        int l = build(2 * node), r = build(2 * node + 1);
+        int winner = beats(r, l) ? r : l;
+        tree[node] = winner == l ? r : l;
+        return winner;
+    }
+
+public:
+    Loser_tree(int k, Beats beats) : k(k), tree(k), beats(std::move(beats)) {
+        tree[0] = build(1);
+    }
+
+    [[nodiscard]] int winner() const { return tree[0]; }
+
+    void replay() {
+        int winner = tree[0];
+        for (int node = (winner + k) / 2; node > 0; node /= 2) {
+            if (beats(tree[node], winner)) {
+                swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+};
+
+class Block_worker {
+    /**
+     * One long-lived background thread per Run_reader or Run_writer that does its block reads or writes, one job
+     * at a time. submit() waits for the previous job and hands over the next; wait() returns whether the last job
+     * succeeded. Pending work is finished before destruction.
+     */
+private:
+    std::mutex lock;
+    std::condition_variable wake;
+    std::function<bool()> job;
+    bool busy = false;
+    bool result = true;
+    bool closing = false;
+    std::thread thread;
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [this]() { return busy || closing; });
+            if (!busy) {
+                return;
+            }
+            guard.unlock();
+            bool ok = false;
+            try {
+                ok = job();
+            } catch (...) {}
+            guard.lock();
+            result = ok;
+            busy = false;
+            wake.notify_all();
+        }
+    }
+
+public:
+    Block_worker() : thread(&Block_worker::run, this) {}
+
+    Block_worker(const Block_worker &) = delete;
+
+    Block_worker &operator=(const Block_worker &) = delete;
+
+    ~Block_worker() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closing = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    bool wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        wake.wait(guard, [this]() { return !busy; });
+        return result;
+    }
+
+    void submit(std::function<bool()> next) {
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job = std::move(next);
+            busy = true;
+        }
+        wake.notify_all();
+    }
+};
+
+template<typename T>
+class Run_reader {
+    /**
+     * Sequential reader of a file of records in blocks. The next block is read in the background while the
+     * current one is consumed. A read error throws instead of ending the run early.
+     */
+private:
+    std::ifstream in;
+    string path;
+    size_t block_records;
+    vector<T> front;
+    vector<T> back;
+    size_t pos;
+    Block_worker worker; //last, so it is joined before the blocks it fills are destroyed.
+
+    bool load(vector<T> &block) {
+        block.resize(block_records);
+        in.read(reinterpret_cast<char *>(block.data()), static_cast<std::streamsize>(sizeof(T) * block_records));
+        block.resize(in.gcount() / sizeof(T));
+        return !in.bad();
+    }
+
+    void refill() {
+        if (!worker.wait()) {
+            throw std::runtime_error("Cannot Read " + path);
+        }
+        swap(front, back);
+        pos = 0;
+        if (!front.empty()) {
+            worker.submit([this]() { return load(back); });
+        }
+    }
+
+public:
+    Run_reader(string path, size_t block_records) :
+            in(path, std::ios::binary), path(std::move(path)), block_records(block_records), pos(0) {
+        if (!in) {
+            throw std::runtime_error("Cannot Open " + this->path);
+        }
+        if (!load(front)) {
+            throw std::runtime_error("Cannot Read " + this->path);
+        }
+        worker.submit([this]() { return load(back); });
+    }
+
+    Run_reader(const Run_reader &) = delete;
+
+    Run_reader &operator=(const Run_reader &) = delete;
+
+    [[nodiscard]] bool empty() const { return pos == front.size(); }
+
+    [[nodiscard]] const T &head() const { return front[pos]; }
+
+    void advance() {
+        if (++pos == front.size()) {
+            refill();
+        }
+    }
+};
+
+template<typename T>
+class Run_writer {
+    /**
+     * Sequential writer of a file of records in blocks. A full block is written in the background while the
+     * next one is filled.
+     */
+private:
+    std::ofstream out;
+    string path;
+    size_t block_records;
+    vector<T> front;
+    vector<T> back;
+    Block_worker worker; //last, so it is joined before the blocks it writes are destroyed.
+
+    void flush() {
+        if (!worker.wait()) {
+            throw std::runtime_error("Cannot Write " + path);
+        }
+        swap(front, back);
+        front.clear();
+        worker.submit([this]() {
+            out.write(reinterpret_cast<const char *>(back.data()), static_cast<std::streamsize>(sizeof(T) * back.size()));
+            return static_cast<bool>(out);
+        });
+    }
+
+public:
+    Run_writer(string path, size_t block_records) :
+            out(path, std::ios::binary | std::ios::trunc), path(std::move(path)), block_records(block_records) {
+        if (!out) {
+            throw std::runtime_error("Cannot Open " + this->path);
+        }
+        front.reserve(block_records);
+        back.reserve(block_records);
+    }
+
+    Run_writer(const Run_writer &) = delete;
+
+    Run_writer &operator=(const Run_writer &) = delete;
+
+    void push(const T &record) {
+        front.push_back(record);
+        if (front.size() == block_records) {
+            flush();
+        }
+    }
+
+    void close() {
+        flush();
+        if (!worker.wait() || !out.flush()) {
+            throw std::runtime_error("Cannot Write " + path);
+        }
+        out.close();
+    }
+};
+
+class Run_files {
+    /**
+     * Names of the run files of one external_sort in temp_dir, created with mkstemp so concurrent sorts never
+     * share a name. Whatever is still listed on destruction is removed, so runs do not outlive a failed sort.
+     */
+private:
+    string dir;
+    vector<string> paths;
+
+public:
+    explicit Run_files(string dir) : dir(std::move(dir)) {}
+
+    Run_files(const Run_files &) = delete;
+
+    Run_files &operator=(const Run_files &) = delete;
+
+    ~Run_files() {
+        for (auto &path: paths) {
+            std::remove(path.c_str());
+        }
+    }
+
+    string create() {
+        string path = dir + "/external_sort.XXXXXX";
+        int fd = mkstemp(path.data());
+        if (fd < 0) {
+            throw std::runtime_error("Cannot Create Run in " + dir);
+        }
+        ::close(fd);
+        paths.push_back(path);
+        return path;
+    }
+
+    void remove(const vector<string> &runs) {
+        for (auto &path: runs) {
+            std::remove(path.c_str());
+            paths.erase(std::find(paths.begin(), paths.end(), path));
+        }
+    }
+};
+
+template<typename T, typename Less>
+void merge_run_files(const vector<string> &inputs, const string &output, size_t block_records, Less &less) {
+    /**
+     * k-way merges sorted record files into output through a loser tree. Ties go to the earlier input.
+     */
+    vector<std::unique_ptr<Run_reader<T>>> readers;
+    for (auto &path: inputs) {
+        readers.push_back(std::make_unique<Run_reader<T>>(path, block_records));
+    }
+    auto beats = [&](int a, int b) {
+        if (readers[a]->empty() || readers[b]->empty()) {
+            return readers[b]->empty() && !readers[a]->empty();
+        }
+        return less(readers[a]->head(), readers[b]->head())
+               || (!less(readers[b]->head(), readers[a]->head()) && a < b);
+    };
+    Loser_tree<decltype(beats)> tree(static_cast<int>(readers.size()), beats);
+    Run_writer<T> writer(output, block_records);
+    while (!readers[tree.winner()]->empty()) {
+        writer.push(readers[tree.winner()]->head());
+        readers[tree.winner()]->advance();
+        tree.replay();
+    }
+    writer.close();
+}
+
+template<typename T, typename Less = std::less<T>>
+void external_sort(const string &input, const string &output, Less less = Less(),
+                   const External_sort_config &config = External_sort_config()) {
+    /**
+     * Sorts a binary file of fixed-size records that may not fit in memory.
+     * Reads memory_limit bytes at a time, sorts them with parallel_quick_sort and spills each chunk as one run
+     * file in temp_dir. Then merges as many runs at once as the double-buffered blocks fit in memory_limit, in as
+     * many passes as needed, the last one into output. Run files are removed even if the sort throws.
+     */
+    static_assert(std::is_trivially_copyable_v<T>, "external_sort requires fixed-size, trivially copyable records");
+    int threads = std::max(config.threads, 1);
+    size_t block_records = std::max<size_t>(config.block_size / sizeof(T), 1);
+    size_t chunk_records = std::max<size_t>(config.memory_limit / sizeof(T), 1);
+    size_t fan_in = std::max<size_t>(config.memory_limit / (2 * block_records * sizeof(T)), 3) - 1;
+    Run_files files(config.temp_dir);
+    vector<string> runs;
+    {
+        std::ifstream in(input, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Cannot Open " + input);
+        }
+        vector<T> chunk(chunk_records);
+        while (in) {
+            in.read(reinterpret_cast<char *>(chunk.data()), static_cast<std::streamsize>(sizeof(T) * chunk_records));
+            if (in.bad()) {
+                throw std::runtime_error("Cannot Read " + input);
+            }
+            size_t bytes = in.gcount();
+            if (bytes % sizeof(T) != 0) {
+                throw std::runtime_error("Partial Record in " + input);
+            }
+            size_t got = bytes / sizeof(T);
+            if (got == 0) {
+                break;
+            }
+            parallel_quick_sort_aux<T>(chunk.begin(), chunk.begin() + got, less, threads);
+            runs.push_back(files.create());
+            std::ofstream out(runs.back(), std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(sizeof(T) * got));
+            if (!out.flush()) {
+                throw std::runtime_error("Cannot Write " + runs.back());
+            }
+        }
+    }
+    while (runs.size() > fan_in) {
+        vector<string> merged;
+        for (size_t i = 0; i < runs.size(); i += fan_in) {
+            vector<string> group(runs.begin() + i, runs.begin() + std::min(i + fan_in, runs.size()));
+            merged.push_back(files.create());
+            merge_run_files<T>(group, merged.back(), block_records, less);
+            files.remove(group);
+        }
+        runs.swap(merged);
+    }
+    if (runs.empty()) {
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        return;
+    }
+    merge_run_files<T>(runs, output, block_records, less);
+    files.remove(runs);
 }
 
 template<typename T>
@@ -1,4 +1,5 @@
 #include "Node.h"
+#include "trace.h"
 #include <iostream>
 
 class EmptyStackException: public std::exception{
@@ -15,24 +16,29 @@ public:
 template<typename T>
 class Stack{
 public:
-    Stack() {
+    Stack(Trace_label where = std::source_location::current()) : trace("Stack", where) {
         head = nullptr;
         size = 0;
     }
     void push(T data){
+        auto timer = trace.time("push");
         head = new Node<T>{std::move(data), head};
+        trace.allocate(sizeof(Node<T>));
+        trace.moved();
         size += 1;
     }
     T pop(){
+        auto timer = trace.time("pop");
         if (size == 0){
             throw EmptyStackException();
         }
-        T data = head->data;
+        T data = std::move(head->data);
+        trace.moved();
         auto new_head = head->next;
         delete head;
         head = new_head;
         size -= 1;
-        return std::move(data);
+        return data;
     }
     T &peek() const{
         if (size == 0){
@@ -45,6 +51,7 @@ public:
 private:
     Node<T> *head;
     int size;
+    [[no_unique_address]] Trace_site trace;
 };
 
 //int main(){
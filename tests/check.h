@@ -0,0 +1,34 @@
+#ifndef DATA_STRUCTURES_CHECK_H
+#define DATA_STRUCTURES_CHECK_H
+#include <iostream>
+
+/*
+ * Minimal assertions for the test executables: a failed CHECK prints its location and expression and the test
+ * keeps going; main() returns check_status(), which is nonzero if anything failed.
+ */
+
+inline int check_failures = 0;
+
+inline void check(bool ok, const char *expr, const char *file, int line) {
+    if (!ok) {
+        std::cerr << file << ":" << line << ": CHECK failed: " << expr << std::endl;
+        check_failures++;
+    }
+}
+
+#define CHECK(expr) check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expr, Error) do { \
+        bool thrown = false; \
+        try { (void) (expr); } catch (const Error &) { thrown = true; } \
+        check(thrown, #expr " throws " #Error, __FILE__, __LINE__); \
+    } while (false)
+
+inline int check_status() {
+    if (check_failures != 0) {
+        std::cerr << check_failures << " check(s) failed" << std::endl;
+    }
+    return check_failures == 0 ? 0 : 1;
+}
+
+#endif //DATA_STRUCTURES_CHECK_H
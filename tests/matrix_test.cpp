@@ -0,0 +1,198 @@
+#include "check.h"
+#include "matrix.cpp"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+/*
+ * Matrix, Matrix_view, Sparse_matrix and Fixed_matrix against naive reference computations, parallel kernels
+ * against serial ones, and text, binary and mapped I/O round trips.
+ */
+
+//small integer entries, so sums of products are exact in double.
+vector<vector<double>> random_rows(int n, int m, uint32_t seed) {
+    std::mt19937 gen(seed);
+    vector<vector<double>> rows(n, vector<double>(m));
+    for (auto &row: rows) {
+        for (auto &x: row) {
+            x = static_cast<double>(static_cast<int>(gen() % 11) - 5);
+        }
+    }
+    return rows;
+}
+
+template<class A, class B>
+bool same(const A &a, const B &b, double eps = 0) {
+    if (a.get_n() != b.get_n() || a.get_m() != b.get_m()) {
+        return false;
+    }
+    for (int i = 0; i < a.get_n(); i++) {
+        for (int j = 0; j < a.get_m(); j++) {
+            if (std::abs(a.get(i, j) - b.get(i, j)) > eps) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+Matrix<double> naive_multiply(const vector<vector<double>> &a, const vector<vector<double>> &b) {
+    vector<vector<double>> c(a.size(), vector<double>(b[0].size(), 0));
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b[0].size(); j++) {
+            for (size_t k = 0; k < b.size(); k++) {
+                c[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+    return Matrix<double>{c};
+}
+
+void test_dense() {
+    auto a = random_rows(70, 90, 1), b = random_rows(90, 50, 2);
+    Matrix<double> A{a}, B{b};
+    auto expected = naive_multiply(a, b);
+    CHECK(same(A * B, expected));
+    CHECK(same(A.multiply(B, Matrix_parallel{4, 1}), expected));
+    CHECK(same(~(~A), A));
+    CHECK(same(A.view().transpose(), ~A));
+    CHECK(same((~B).multiply(~A), ~expected));
+    CHECK(same(A.view().submatrix(3, 4, 10, 20).multiply(B.view().submatrix(4, 0, 20, 5)),
+               naive_multiply(Matrix<double>{A.view().submatrix(3, 4, 10, 20)}.to_vector(),
+                              Matrix<double>{B.view().submatrix(4, 0, 20, 5)}.to_vector())));
+    auto sum = A + A;
+    CHECK(sum.get(5, 7) == 2 * A.get(5, 7));
+    CHECK(same(A.add(A, Matrix_parallel{3, 1}), sum));
+    CHECK(same(A.rref(Matrix_parallel{4, 1}), A.rref()));
+    CHECK_THROWS(A * A, std::invalid_argument);
+    CHECK_THROWS(A.view().submatrix(60, 0, 20, 1), std::invalid_argument);
+
+    Matrix<double> C{vector<vector<double>>{{2, 3, 1}, {1, 2, 1}, {1, 1, 1}}};
+    CHECK(C.det() == 1);
+    CHECK(same(C * !C, Matrix<double>{vector<vector<double>>{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}}, 1e-12));
+    Matrix<double> singular{vector<vector<double>>{{1, 2}, {2, 4}}};
+    CHECK(singular.det() == 0);
+    CHECK_THROWS(!singular, std::invalid_argument);
+}
+
+void test_sparse() {
+    auto a = random_rows(40, 30, 3);
+    for (auto &row: a) {
+        for (auto &x: row) {
+            x = x > 2 ? x : 0;
+        }
+    }
+    Matrix<double> A{a};
+    Sparse_matrix<double> S{A};
+    CHECK(same(S.to_dense(), A));
+    CHECK(same(S.transpose().to_dense(), ~A));
+    CHECK(same((S + S).to_dense(), A + A));
+    auto b = random_rows(30, 6, 4);
+    CHECK(same(S * Matrix<double>{b}, naive_multiply(a, b)));
+    vector<double> x(30);
+    for (int j = 0; j < 30; j++) {
+        x[j] = j - 10;
+    }
+    auto y = S * x;
+    for (int i = 0; i < 40; i++) {
+        double expected = 0;
+        for (int j = 0; j < 30; j++) {
+            expected += a[i][j] * x[j];
+        }
+        CHECK(y[i] == expected);
+    }
+    auto T = Sparse_matrix<double>::from_triplets(3, 4, {{2, 3, 1.0}, {0, 1, 2.0}, {2, 3, 4.0}, {1, 0, -1.0}});
+    CHECK(T.nonzeros() == 3);
+    CHECK(T.get(2, 3) == 5.0);
+    CHECK(T.get(0, 1) == 2.0);
+    CHECK(T.get(1, 1) == 0.0);
+    //entries that cancel out, or are zero to begin with, are not stored, as in add().
+    CHECK(Sparse_matrix<double>::from_triplets(2, 2, {{0, 0, 1.0}, {0, 0, -1.0}, {1, 1, 0.0}}).nonzeros() == 0);
+    CHECK_THROWS(Sparse_matrix<double>::from_triplets(3, 4, {{3, 0, 1.0}}), std::invalid_argument);
+}
+
+void test_fixed() {
+    constexpr Fixed_matrix<double, 3, 3> F{{2, 3, 1}, {1, 2, 1}, {1, 1, 1}};
+    static_assert(F.det() == 1, "Fixed_matrix.det() is evaluated at compile time");
+    static_assert((F * F.inverse()).get(2, 2) == 1, "Fixed_matrix.inverse() is evaluated at compile time");
+    CHECK(same(F * !F, Fixed_matrix<double, 3, 3>::identity()));
+    CHECK(same(F.to_matrix() * F.to_matrix(), F * F));
+    CHECK(same(~F, ~F.to_matrix()));
+    Fixed_matrix<double, 4, 4> G{{2, 0, 1, 0}, {1, 3, 2, 0}, {1, 1, 1, 1}, {0, 0, 1, 4}};
+    CHECK(std::abs(G.det() - G.to_matrix().det()) < 1e-12);
+    CHECK(same(G * G.inverse(), Fixed_matrix<double, 4, 4>::identity(), 1e-12));
+    CHECK(same(Fixed_matrix<double, 4, 4>(G.to_matrix()), G));
+    CHECK_THROWS((Fixed_matrix<double, 2, 2>{{1, 2}, {2, 4}}.inverse()), std::invalid_argument);
+}
+
+void test_io() {
+    Matrix<double> A{vector<vector<double>>{{0.1, -2.5, 1e-300}, {3, 1.0 / 3, -0.0}}};
+    std::stringstream text;
+    A.write_text(text);
+    CHECK(same(Matrix<double>::read_text(text), A));
+    std::stringstream transposed;
+    A.view().transpose().write_text(transposed);
+    CHECK(same(Matrix<double>::read_text(transposed), ~A));
+    std::stringstream binary;
+    A.view().transpose().write_binary(binary);
+    CHECK(same(Matrix<double>::read_binary(binary), ~A));
+    std::stringstream several;
+    A.write_text(several);
+    (~A).write_text(several);
+    several << "tail";
+    CHECK(same(Matrix<double>::read_text(several), A));
+    CHECK(same(Matrix<double>::read_text(several), ~A));
+    string rest;
+    CHECK(several >> rest && rest == "tail");
+    std::stringstream unterminated("1 2\n5 6");
+    CHECK(same(Matrix<double>::read_text(unterminated), Matrix<double>{vector<vector<double>>{{5, 6}}}));
+    //an entry longer than the parse buffer is rejected, not split into two entries.
+    std::stringstream long_row("1 2\n0." + string(200, '0') + "1 5\n");
+    CHECK_THROWS(Matrix<double>::read_text(long_row), std::runtime_error);
+    std::stringstream long_col("2 1\n0." + string(200, '0') + "1\n5\n");
+    CHECK_THROWS(Matrix<double>::read_text(long_col), std::runtime_error);
+    //Matrix<bool> cannot exist (vector<bool> has no data()), but a view over bools can be written.
+    bool flags[] = {true, false, false, true};
+    std::stringstream flags_text;
+    Matrix_view<bool>{flags, 2, 2, 2, 1}.write_text(flags_text);
+    CHECK(same(Matrix<int>::read_text(flags_text), Matrix<int>{vector<vector<int>>{{1, 0}, {0, 1}}}));
+    std::stringstream huge("3037000500 3037000500\n1\n");
+    CHECK_THROWS(Matrix<double>::read_text(huge), std::runtime_error);
+    std::stringstream wide("1 2147483648\n1\n");
+    CHECK_THROWS(Matrix<double>::read_text(wide), std::runtime_error);
+    std::stringstream malformed("2 2\n1 2\n3 x\n");
+    CHECK_THROWS(Matrix<double>::read_text(malformed), std::runtime_error);
+    std::stringstream truncated(binary.str().substr(0, binary.str().size() - 1));
+    CHECK_THROWS(Matrix<double>::read_binary(truncated), std::runtime_error);
+    Matrix_header header{{}, sizeof(double), 1L << 32, 1L << 32};
+    std::memcpy(header.magic, Matrix_header::MAGIC, sizeof(header.magic));
+    std::stringstream overflowing(string(reinterpret_cast<const char *>(&header), sizeof(header)));
+    CHECK_THROWS(Matrix<double>::read_binary(overflowing), std::runtime_error);
+
+    char path[] = "/tmp/matrix_test.XXXXXX";
+    close(mkstemp(path));
+    {
+        std::ofstream out(path, std::ios::binary);
+        A.write_binary(out);
+    }
+    {
+        Mapped_matrix<double> mapped(path);
+        CHECK(same(mapped.view(), A));
+    }
+    CHECK_THROWS(Mapped_matrix<float>(path), std::runtime_error);
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    CHECK_THROWS(Mapped_matrix<double>(path), std::runtime_error);
+    std::remove(path);
+}
+
+int main() {
+    test_dense();
+    test_sparse();
+    test_fixed();
+    test_io();
+    return check_status();
+}
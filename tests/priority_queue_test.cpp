@@ -0,0 +1,111 @@
+#include "check.h"
+#include "priority_queue.cpp"
+#include <algorithm>
+#include <random>
+
+/*
+ * Priority_queue and Indexed_priority_queue against sorted reference sequences, for several heap arities.
+ */
+
+vector<int> random_keys(int n, uint32_t seed = 5) {
+    std::mt19937 gen(seed);
+    vector<int> v(n);
+    for (auto &x: v) {
+        x = static_cast<int>(gen() % 1000);
+    }
+    return v;
+}
+
+template<typename Q>
+vector<int> drain(Q &queue) {
+    vector<int> out;
+    while (!queue.empty()) {
+        CHECK(queue.top() == queue.top());
+        out.push_back(queue.pop());
+    }
+    return out;
+}
+
+template<int D>
+void test_priority_queue() {
+    for (int n: {1, 2, 5, 100, 1000}) {
+        auto keys = random_keys(n);
+        auto sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+        Priority_queue<int, std::less<int>, D> pushed;
+        for (int k: keys) {
+            pushed.push(k);
+        }
+        CHECK(pushed.get_size() == n);
+        CHECK(drain(pushed) == sorted);
+        Priority_queue<int, std::less<int>, D> heapified(keys.begin(), keys.end());
+        CHECK(heapified.get_size() == n);
+        CHECK(drain(heapified) == sorted);
+        Priority_queue<int, std::greater<int>, D> max_heap(keys.begin(), keys.end());
+        std::reverse(sorted.begin(), sorted.end());
+        CHECK(drain(max_heap) == sorted);
+    }
+    Priority_queue<int, std::less<int>, D> empty;
+    CHECK(empty.empty());
+    CHECK_THROWS(empty.pop(), EmptyPriorityQueueException);
+    CHECK_THROWS(empty.top(), EmptyPriorityQueueException);
+    vector<int> none;
+    Priority_queue<int, std::less<int>, D> heapified(none.begin(), none.end());
+    CHECK(heapified.empty());
+    heapified.push(3);
+    CHECK(heapified.pop() == 3);
+}
+
+template<int D>
+void test_indexed_priority_queue() {
+    auto keys = random_keys(500, 6);
+    Indexed_priority_queue<int, std::less<int>, D> queue;
+    vector<int> handles;
+    for (int k: keys) {
+        handles.push_back(queue.push(k));
+    }
+    //decrease every third key, raise every fifth, erase every seventh; mirror it in `expected`.
+    vector<int> expected;
+    for (int i = 0; i < 500; i++) {
+        int h = handles[i];
+        CHECK(queue.get(h) == keys[i]);
+        if (i % 7 == 0) {
+            queue.erase(h);
+            CHECK(!queue.contains(h));
+            continue;
+        }
+        int key = keys[i];
+        if (i % 3 == 0) {
+            key -= 2000;
+            queue.decrease_key(h, key);
+        } else if (i % 5 == 0) {
+            key += 2000;
+            queue.update(h, key);
+        }
+        CHECK(queue.get(h) == key);
+        expected.push_back(key);
+    }
+    std::sort(expected.begin(), expected.end());
+    CHECK(queue.get_size() == static_cast<int>(expected.size()));
+    CHECK(queue.get(queue.top_handle()) == expected.front());
+    CHECK_THROWS(queue.decrease_key(queue.top_handle(), expected.front() + 1), std::invalid_argument);
+    CHECK(drain(queue) == expected);
+    CHECK_THROWS(queue.get(handles[1]), Invalid_handle_error);
+    CHECK_THROWS(queue.erase(-1), Invalid_handle_error);
+    CHECK_THROWS(queue.pop(), EmptyPriorityQueueException);
+    //freed handles are reused.
+    int h = queue.push(1);
+    CHECK(std::find(handles.begin(), handles.end(), h) != handles.end());
+    CHECK(queue.pop() == 1);
+}
+
+int main() {
+    //several arities with the same element type and order: GCC 12 at -O3 once merged the max-heap pop() of
+    //arities 4 and 7 into one function when least_child() was written with pointer selects.
+    test_priority_queue<2>();
+    test_priority_queue<4>();
+    test_priority_queue<7>();
+    test_indexed_priority_queue<2>();
+    test_indexed_priority_queue<4>();
+    return check_status();
+}
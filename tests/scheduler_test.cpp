@@ -0,0 +1,100 @@
+#include "check.h"
+#include "scheduler.h"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+ * Task_group and Scheduler::parallel_for on pools of several sizes, from outside the pool and nested inside tasks.
+ */
+
+//every index of [0, n) is visited exactly once. A pool without workers runs the whole range at once. The caller,
+//outside the pool, runs the first range itself rather than only waiting for the workers.
+void test_parallel_for(Scheduler &scheduler) {
+    for (long grain: {1, 7, 1000}) {
+        const long n = 10000;
+        std::vector<std::atomic<int>> seen(n);
+        std::atomic<bool> first_on_caller{false};
+        auto caller = std::this_thread::get_id();
+        scheduler.parallel_for(0, n, grain, [&](long lo, long hi) {
+            CHECK(hi - lo <= grain || scheduler.threads() == 1);
+            if (lo == 0) {
+                first_on_caller = std::this_thread::get_id() == caller;
+            }
+            for (long k = lo; k < hi; k++) {
+                seen[k]++;
+            }
+        });
+        long once = 0;
+        for (auto &s: seen) {
+            once += s.load() == 1;
+        }
+        CHECK(once == n);
+        CHECK(first_on_caller);
+    }
+}
+
+//a parallel_for in every iteration of another one used to run the outer ranges on the stack of waiting threads,
+//one inside the other, until it overflowed.
+void test_nested_parallel_for(Scheduler &scheduler) {
+    std::atomic<long> count{0};
+    scheduler.parallel_for(0, 4000, 1, [&](long lo, long hi) {
+        for (long k = lo; k < hi; k++) {
+            scheduler.parallel_for(0, 16, 1, [&](long l, long h) { count += h - l; });
+        }
+    });
+    CHECK(count == 4000 * 16);
+    count = 0;
+    auto level = [&](auto &&inner) {
+        return [&scheduler, inner](long lo, long hi) {
+            for (long k = lo; k < hi; k++) {
+                scheduler.parallel_for(0, 64, 1, inner);
+            }
+        };
+    };
+    scheduler.parallel_for(0, 64, 1, level(level([&](long lo, long hi) { count += hi - lo; })));
+    CHECK(count == 64 * 64 * 64);
+}
+
+long fibonacci(Scheduler &scheduler, int n) {
+    if (n < 2) {
+        return n;
+    }
+    long a, b;
+    Task_group group(scheduler);
+    group.spawn([&] { a = fibonacci(scheduler, n - 1); });
+    b = fibonacci(scheduler, n - 2);
+    group.sync();
+    return a + b;
+}
+
+void test_task_group(Scheduler &scheduler) {
+    CHECK(fibonacci(scheduler, 20) == 6765);
+    Task_group group(scheduler);
+    std::atomic<int> ran{0};
+    for (int t = 0; t < 100; t++) {
+        group.spawn([&ran, t] {
+            ran++;
+            if (t == 42) {
+                throw std::runtime_error("task 42");
+            }
+        });
+    }
+    CHECK_THROWS(group.sync(), std::runtime_error);
+    CHECK(ran == 100);
+    //the error was delivered once; the group can be reused.
+    group.spawn([&ran] { ran++; });
+    group.sync();
+    CHECK(ran == 101);
+}
+
+int main() {
+    for (int threads: {1, 2, 8}) {
+        Scheduler scheduler(threads);
+        CHECK(scheduler.threads() == threads);
+        test_parallel_for(scheduler);
+        test_nested_parallel_for(scheduler);
+        test_task_group(scheduler);
+    }
+    return check_status();
+}
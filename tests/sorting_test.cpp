@@ -0,0 +1,228 @@
+#include "check.h"
+#include "sorting.cpp"
+#include <filesystem>
+#include <random>
+
+/*
+ * Every sort against std::sort over several sizes and input shapes, stability of the stable sorts, the selection
+ * functions, and external_sort round trips through files.
+ */
+
+vector<int> make_input(const string &shape, int n, uint32_t seed = 1) {
+    std::mt19937 gen(seed);
+    vector<int> v(n);
+    for (auto &x: v) {
+        x = static_cast<int>(gen() % 1000000) - 500000; //small enough for comp_int not to overflow.
+    }
+    if (shape == "sorted") {
+        std::sort(v.begin(), v.end());
+    } else if (shape == "reversed") {
+        std::sort(v.rbegin(), v.rend());
+    } else if (shape == "few_unique") {
+        for (auto &x: v) {
+            x %= 4;
+        }
+    }
+    return v;
+}
+
+template<typename Sort>
+void check_sort(const string &name, Sort sort, int max_size) {
+    for (string shape: {"random", "sorted", "reversed", "few_unique"}) {
+        for (int n: {0, 1, 2, 17, 1000, 50000}) {
+            if (n > max_size) {
+                continue;
+            }
+            auto v = make_input(shape, n);
+            auto expected = v;
+            std::sort(expected.begin(), expected.end());
+            sort(v);
+            if (v != expected) {
+                std::cerr << name << " on " << n << " " << shape << " keys" << std::endl;
+            }
+            CHECK(v == expected);
+        }
+    }
+}
+
+void test_sorts() {
+    check_sort("bubble_sort", [](vector<int> &v) { bubble_sort(v); }, 1000);
+    check_sort("insertion_sort", [](vector<int> &v) { insertion_sort(v, comp_int); }, 1000);
+    check_sort("merge_sort", [](vector<int> &v) { merge_sort(v, comp_int); }, 50000);
+    check_sort("quick_sort", [](vector<int> &v) { quick_sort(v, comp_int); }, 50000);
+    check_sort("intro_sort", [](vector<int> &v) { intro_sort(v); }, 50000);
+    check_sort("tim_sort", [](vector<int> &v) { tim_sort(v); }, 50000);
+    check_sort("radix_sort", [](vector<int> &v) { radix_sort(v); }, 50000);
+    check_sort("parallel_merge_sort", [](vector<int> &v) { parallel_merge_sort(v, comp_int, 4); }, 50000);
+    check_sort("parallel_quick_sort", [](vector<int> &v) { parallel_quick_sort(v, comp_int, 4); }, 50000);
+    check_sort("parallel_radix_sort", [](vector<int> &v) { parallel_radix_sort(v, 4); }, 50000);
+    check_sort("descending", [](vector<int> &v) {
+        intro_sort(v, std::greater<int>());
+        std::reverse(v.begin(), v.end());
+    }, 50000);
+}
+
+void test_radix_keys() {
+    vector<double> d{3.5, -0.0, -2.25, 1e300, -1e-300, 0.0, -7.0, 2.0};
+    auto expected = d;
+    std::sort(expected.begin(), expected.end());
+    radix_sort(d);
+    CHECK(d == expected);
+    vector<long> l{LONG_MAX, -1, LONG_MIN, 0, 42, -42};
+    auto expected_l = l;
+    std::sort(expected_l.begin(), expected_l.end());
+    parallel_radix_sort(l, 3);
+    CHECK(l == expected_l);
+    //a key that cannot be read from a moved-from record: the skip test of each pass must not look at one.
+    vector<std::unique_ptr<int>> boxes;
+    for (int x: make_input("random", 1000, 2)) {
+        boxes.push_back(std::make_unique<int>(x));
+    }
+    radix_sort(boxes, [](const std::unique_ptr<int> &p) { return *p; });
+    CHECK(std::is_sorted(boxes.begin(), boxes.end(), [](auto &a, auto &b) { return *a < *b; }));
+}
+
+vector<Student> make_students(int n) {
+    vector<Student> v;
+    for (int i = 0; i < n; i++) {
+        v.emplace_back(i * 7 % 5 / 2.0, "student" + std::to_string(i));
+    }
+    return v;
+}
+
+//the sort kept students with equal gpa in input order, which make_students() made the order of their numbers.
+bool stable_by_gpa(const vector<Student> &v) {
+    for (size_t i = 1; i < v.size(); i++) {
+        if (v[i - 1].gpa > v[i].gpa) {
+            return false;
+        }
+        if (v[i - 1].gpa == v[i].gpa && std::stoi(v[i - 1].name.substr(7)) > std::stoi(v[i].name.substr(7))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Student has no default constructor, so these also check that no sort needs one.
+void test_stable_sorts() {
+    auto gpa = [](const Student &s) { return s.gpa; };
+    comparator<Student> by_gpa = [](const Student &a, const Student &b) { return a.gpa < b.gpa ? -1 : a.gpa > b.gpa; };
+    for (int n: {0, 1, 100, 20000}) {
+        auto v = make_students(n);
+        merge_sort(v, by_gpa);
+        CHECK(stable_by_gpa(v));
+        v = make_students(n);
+        parallel_merge_sort(v, by_gpa, 4);
+        CHECK(stable_by_gpa(v));
+        v = make_students(n);
+        parallel_quick_sort(v, by_gpa, 4);
+        CHECK(std::is_sorted(v.begin(), v.end(), [](const Student &a, const Student &b) { return a.gpa < b.gpa; }));
+        v = make_students(n);
+        tim_sort(v, [](const Student &a, const Student &b) { return a.gpa < b.gpa; });
+        CHECK(stable_by_gpa(v));
+        v = make_students(n);
+        radix_sort(v, gpa);
+        CHECK(stable_by_gpa(v));
+        v = make_students(n);
+        parallel_radix_sort(v, gpa, 4);
+        CHECK(stable_by_gpa(v));
+        v = make_students(n);
+        tagged_sort(v, gpa);
+        CHECK(stable_by_gpa(v));
+    }
+}
+
+void test_permutations() {
+    auto v = make_input("random", 5000);
+    auto perm = sort_permutation(v, [](int x) { return x; });
+    auto sorted = gather(v, perm);
+    CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+    v = make_input("random", 5000);
+    apply_permutation(v, perm);
+    CHECK(v == sorted);
+}
+
+void test_selection() {
+    auto input = make_input("random", 500, 3);
+    auto sorted = input;
+    std::sort(sorted.begin(), sorted.end());
+    for (int nth = 0; nth < 500; nth += 7) {
+        auto v = input;
+        nth_element(v, nth, comp_int);
+        CHECK(v[nth] == sorted[nth]);
+        CHECK(std::all_of(v.begin(), v.begin() + nth, [&](int x) { return x <= v[nth]; }));
+        CHECK(std::all_of(v.begin() + nth, v.end(), [&](int x) { return x >= v[nth]; }));
+    }
+    auto few = make_input("few_unique", 3000, 4);
+    auto few_sorted = few;
+    std::sort(few_sorted.begin(), few_sorted.end());
+    nth_element(few, 1500, comp_int);
+    CHECK(few[1500] == few_sorted[1500]);
+    for (int k: {0, 1, 10, 499, 500, 600}) {
+        auto v = input;
+        partial_sort(v, k, comp_int);
+        auto top = std::min(k, 500);
+        CHECK(std::equal(v.begin(), v.begin() + top, sorted.begin()));
+        Top_k<int> streaming(k, comp_int);
+        for (int x: input) {
+            streaming.push(x);
+        }
+        CHECK(streaming.get_size() == top);
+        CHECK(streaming.result() == vector<int>(sorted.begin(), sorted.begin() + top));
+    }
+    Top_k<int> none(-1, comp_int);
+    none.push(1);
+    CHECK(none.get_size() == 0);
+}
+
+void write_ints(const string &path, const vector<int> &v) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(int)));
+}
+
+vector<int> read_ints(const string &path) {
+    std::ifstream in(path, std::ios::binary);
+    vector<int> v;
+    int x;
+    while (in.read(reinterpret_cast<char *>(&x), sizeof(x))) {
+        v.push_back(x);
+    }
+    return v;
+}
+
+void test_external_sort() {
+    char dir_template[] = "/tmp/external_sort_test.XXXXXX";
+    string dir = mkdtemp(dir_template);
+    External_sort_config config;
+    config.memory_limit = 1 << 14; //a few hundred runs and more than one merge pass.
+    config.block_size = 1 << 10;
+    config.temp_dir = dir;
+    config.threads = 3;
+    for (int n: {0, 1, 1000, 200000}) {
+        auto v = make_input("random", n);
+        write_ints(dir + "/in", v);
+        external_sort<int>(dir + "/in", dir + "/out", std::less<int>(), config);
+        std::sort(v.begin(), v.end());
+        CHECK(read_ints(dir + "/out") == v);
+        //only the input and output are left in temp_dir.
+        CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 2);
+    }
+    CHECK_THROWS(external_sort<int>(dir + "/missing", dir + "/out", std::less<int>(), config), std::runtime_error);
+    //a directory opens but fails on the first read: an error, not an empty input.
+    CHECK_THROWS(external_sort<int>(dir, dir + "/out", std::less<int>(), config), std::runtime_error);
+    //the final merge cannot open its output: the runs spilled so far are removed on the way out.
+    std::filesystem::remove(dir + "/out");
+    CHECK_THROWS(external_sort<int>(dir + "/in", dir + "/missing/out", std::less<int>(), config), std::runtime_error);
+    CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 1);
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    test_sorts();
+    test_radix_keys();
+    test_stable_sorts();
+    test_permutations();
+    test_selection();
+    test_external_sort();
+    return check_status();
+}
@@ -0,0 +1,340 @@
+#ifndef DATA_STRUCTURES_TRACE_H
+#define DATA_STRUCTURES_TRACE_H
+#include <cstddef>
+#include <ostream>
+#include <source_location>
+#ifdef PRACTICE_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#endif
+
+/*
+ * Allocation and operation tracing for the containers, Matrix and the sorts, compiled in only when PRACTICE_TRACE
+ * is defined (cmake -DPRACTICE_TRACE=ON). Every container and Matrix instance owns a Trace_site labelled with its
+ * kind and a Trace_label, by default the source location that constructed it; every call of one sort shares a single
+ * site. A site counts allocations, allocated bytes, element copies and moves, and the count, total and worst latency
+ * of each operation. Trace_registry::snapshot() writes one JSON object per line for every call site, summing
+ * its live and destroyed instances, so short-lived containers still show up. Every line carries the number of the
+ * snapshot it belongs to and its wall-clock time, "ts", in milliseconds since the Unix epoch, so successive
+ * snapshots in one log can be told apart. Trace_reporter writes a snapshot periodically from a background thread.
+ *
+ * Without PRACTICE_TRACE, Trace_site is an empty class whose members do nothing, stored [[no_unique_address]], so
+ * containers keep their size and every hook compiles away.
+ */
+
+//what a container's statistics are reported under. Containers and Matrix take one as their last constructor
+//argument, defaulting to the source location of the constructor call. When the constructor runs inside
+//std::make_unique, std::make_shared or emplace_back, that location is in the standard library header, so every
+//such container lands on one site; pass a name, or std::source_location::current(), through those calls instead:
+//    auto list = std::make_unique<Linked_list<int>>("parser tokens");
+struct Trace_label {
+    const char *name = nullptr;
+    std::source_location where;
+
+    constexpr Trace_label(const char *name) : name(name) {}
+
+    constexpr Trace_label(std::source_location where) : where(where) {}
+};
+
+#ifdef PRACTICE_TRACE
+
+class Trace_site;
+
+//totals of one site, or of all retired sites of one call site.
+struct Trace_totals {
+    static const int MAX_OPS = 8;
+
+    struct Op {
+        const char *name = nullptr;
+        long count = 0;
+        long total_ns = 0;
+        long max_ns = 0;
+    };
+
+    long instances = 0;
+    long allocations = 0;
+    long bytes = 0;
+    long copies = 0;
+    long moves = 0;
+    Op ops[MAX_OPS];
+
+    void add(const Trace_totals &other){
+        instances += other.instances;
+        allocations += other.allocations;
+        bytes += other.bytes;
+        copies += other.copies;
+        moves += other.moves;
+        for (auto &op: other.ops){
+            if (op.name == nullptr){
+                break;
+            }
+            for (auto &mine: ops){
+                if (mine.name == nullptr || std::strcmp(mine.name, op.name) == 0){
+                    mine.name = op.name;
+                    mine.count += op.count;
+                    mine.total_ns += op.total_ns;
+                    mine.max_ns = std::max(mine.max_ns, op.max_ns);
+                    break;
+                }
+            }
+        }
+    }
+
+    void write(std::ostream &os) const{
+        os << "\"instances\": " << instances << ", \"allocations\": " << allocations << ", \"bytes\": " << bytes
+           << ", \"copies\": " << copies << ", \"moves\": " << moves
+           << ", \"ops\": {";
+        for (int i = 0; i < MAX_OPS && ops[i].name != nullptr; i++){
+            os << (i == 0 ? "" : ", ") << "\"" << ops[i].name << "\": {\"count\": " << ops[i].count
+               << ", \"total_ns\": " << ops[i].total_ns << ", \"max_ns\": " << ops[i].max_ns << "}";
+        }
+        os << "}";
+    }
+};
+
+class Trace_registry {
+public:
+    static Trace_registry &instance(){
+        static Trace_registry registry;
+        return registry;
+    }
+
+    //one JSON object per call site, with the totals of its live and destroyed instances.
+    void snapshot(std::ostream &os);
+
+private:
+    friend class Trace_site;
+    std::mutex lock;
+    std::set<Trace_site *> live;
+    std::map<std::string, Trace_totals> retired; //keyed by Trace_site::label().
+    long snapshots = 0;
+
+    void enroll(Trace_site *site){
+        std::lock_guard<std::mutex> guard(lock);
+        live.insert(site);
+    }
+
+    void retire(Trace_site *site);
+};
+
+class Trace_site {
+public:
+    //times one operation from construction to destruction.
+    class Timer {
+    public:
+        Timer(Trace_site *site, int slot) : site(site), slot(slot), start(std::chrono::steady_clock::now()) {}
+
+        Timer(const Timer &) = delete;
+
+        Timer &operator=(const Timer &) = delete;
+
+        ~Timer(){
+            if (slot < 0){
+                return;
+            }
+            long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            auto &op = site->ops[slot];
+            op.count.fetch_add(1, std::memory_order_relaxed);
+            op.total_ns.fetch_add(ns, std::memory_order_relaxed);
+            long max = op.max_ns.load(std::memory_order_relaxed);
+            while (ns > max && !op.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+        }
+
+    private:
+        Trace_site *site;
+        int slot;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    explicit Trace_site(const char *kind, Trace_label where = std::source_location::current()) :
+            kind(kind), where(where) {
+        Trace_registry::instance().enroll(this);
+    }
+
+    //a copy of a container is a new instance attributed to the same call site.
+    Trace_site(const Trace_site &other) : Trace_site(other.kind, other.where) {}
+
+    Trace_site &operator=(const Trace_site &) { return *this; }
+
+    ~Trace_site(){ Trace_registry::instance().retire(this); }
+
+    void allocate(size_t bytes, long count = 1){
+        allocations.fetch_add(count, std::memory_order_relaxed);
+        this->bytes.fetch_add(static_cast<long>(bytes), std::memory_order_relaxed);
+    }
+
+    void copied(long count = 1){ copies.fetch_add(count, std::memory_order_relaxed); }
+
+    void moved(long count = 1){ moves.fetch_add(count, std::memory_order_relaxed); }
+
+    //op must be a string literal; it names the operation in snapshots.
+    Timer time(const char *op){ return Timer(this, slot(op)); }
+
+    //"kind name" for a named site, "kind file:line" otherwise.
+    [[nodiscard]] std::string label() const{
+        if (where.name != nullptr){
+            return std::string(kind) + " " + where.name;
+        }
+        return std::string(kind) + " " + where.where.file_name() + ":" + std::to_string(where.where.line());
+    }
+
+    [[nodiscard]] Trace_totals totals() const{
+        Trace_totals t;
+        t.instances = 1;
+        t.allocations = allocations.load(std::memory_order_relaxed);
+        t.bytes = bytes.load(std::memory_order_relaxed);
+        t.copies = copies.load(std::memory_order_relaxed);
+        t.moves = moves.load(std::memory_order_relaxed);
+        for (int i = 0; i < Trace_totals::MAX_OPS; i++){
+            t.ops[i].name = ops[i].name.load(std::memory_order_acquire);
+            t.ops[i].count = ops[i].count.load(std::memory_order_relaxed);
+            t.ops[i].total_ns = ops[i].total_ns.load(std::memory_order_relaxed);
+            t.ops[i].max_ns = ops[i].max_ns.load(std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+private:
+    struct Op {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<long> count{0};
+        std::atomic<long> total_ns{0};
+        std::atomic<long> max_ns{0};
+    };
+
+    const char *kind;
+    Trace_label where;
+    std::atomic<long> allocations{0};
+    std::atomic<long> bytes{0};
+    std::atomic<long> copies{0};
+    std::atomic<long> moves{0};
+    Op ops[Trace_totals::MAX_OPS];
+
+    //slot of op, claimed on first use; -1 once every slot holds another operation.
+    int slot(const char *op){
+        for (int i = 0; i < Trace_totals::MAX_OPS; i++){
+            const char *name = ops[i].name.load(std::memory_order_acquire);
+            if (name == nullptr && ops[i].name.compare_exchange_strong(name, op, std::memory_order_acq_rel)){
+                return i;
+            }
+            if (name == op || std::strcmp(name, op) == 0){
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+inline void Trace_registry::retire(Trace_site *site){
+    auto totals = site->totals();
+    std::lock_guard<std::mutex> guard(lock);
+    live.erase(site);
+    retired[site->label()].add(totals);
+}
+
+inline void Trace_registry::snapshot(std::ostream &os){
+    std::lock_guard<std::mutex> guard(lock);
+    long id = ++snapshots;
+    long ts = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    std::map<std::string, std::pair<long, Trace_totals>> sites{};
+    for (auto site: live){
+        auto &[count, totals] = sites[site->label()];
+        count++;
+        totals.add(site->totals());
+    }
+    for (auto &[label, totals]: retired){
+        sites[label].second.add(totals);
+    }
+    for (auto &[label, entry]: sites){
+        os << "{\"snapshot\": " << id << ", \"ts\": " << ts << ", \"site\": \"" << label << "\", \"live\": "
+           << entry.first << ", ";
+        entry.second.write(os);
+        os << "}\n";
+    }
+    os.flush();
+}
+
+//writes Trace_registry::snapshot() to os every `interval` until destroyed, and once more on destruction.
+class Trace_reporter {
+public:
+    Trace_reporter(std::ostream &os, std::chrono::milliseconds interval) : os(os), interval(interval),
+            worker([this]{ loop(); }) {}
+
+    Trace_reporter(const Trace_reporter &) = delete;
+
+    Trace_reporter &operator=(const Trace_reporter &) = delete;
+
+    ~Trace_reporter(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+        Trace_registry::instance().snapshot(os);
+    }
+
+private:
+    std::ostream &os;
+    std::chrono::milliseconds interval;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread worker;
+
+    void loop(){
+        std::unique_lock<std::mutex> guard(lock);
+        while (!wake.wait_for(guard, interval, [this]{ return stopping; })){
+            Trace_registry::instance().snapshot(os);
+        }
+    }
+};
+
+#else
+
+class Trace_site {
+public:
+    struct Timer {
+        constexpr ~Timer() {} //user-provided, so unused timers do not warn.
+    };
+
+    constexpr explicit Trace_site(const char *, Trace_label = std::source_location::current()) {}
+
+    constexpr void allocate(size_t, long = 1) const {}
+
+    constexpr void copied(long = 1) const {}
+
+    constexpr void moved(long = 1) const {}
+
+    constexpr Timer time(const char *) const{ return {}; }
+};
+
+class Trace_registry {
+public:
+    static Trace_registry &instance(){
+        static Trace_registry registry;
+        return registry;
+    }
+
+    void snapshot(std::ostream &) {}
+};
+
+class Trace_reporter {
+public:
+    template<class Duration>
+    Trace_reporter(std::ostream &, Duration) {}
+};
+
+#endif
+
+#endif //DATA_STRUCTURES_TRACE_H